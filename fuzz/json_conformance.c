@@ -0,0 +1,62 @@
+#include "json_differential.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Runs a JSONTestSuite style corpus. Files starting with y_ must be accepted,
+// n_ must be rejected and i_ may go either way. Every file also goes through the
+// differential check, which aborts if the parser modes disagree
+static int check_file(const char* dir, const char* name)
+{
+	char path[4096];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		perror(path);
+		return 0;
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	char* data = malloc(size > 0 ? size : 1);
+	size_t read = fread(data, 1, size, file);
+	fclose(file);
+
+	int valid = json_differential_check(data, read);
+	free(data);
+
+	if ((name[0] == 'y' && !valid) || (name[0] == 'n' && valid)) {
+		printf("FAIL %s: %s\n", name, valid ? "accepted" : "rejected");
+		return 0;
+	}
+	return 1;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s corpus_directory\n", argv[0]);
+		return 2;
+	}
+	DIR* dir = opendir(argv[1]);
+	if (!dir) {
+		perror(argv[1]);
+		return 2;
+	}
+
+	int files = 0;
+	int failures = 0;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL) {
+		const char* name = entry->d_name;
+		if ((name[0] != 'y' && name[0] != 'n' && name[0] != 'i') || name[1] != '_') continue;
+		++files;
+		if (!check_file(argv[1], name)) ++failures;
+	}
+	closedir(dir);
+
+	printf("json_conformance: %d files, %d failures\n", files, failures);
+	return (failures == 0 && files > 0) ? 0 : 1;
+}
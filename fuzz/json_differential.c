@@ -0,0 +1,341 @@
+#include "json_differential.h"
+
+#include "json.h"
+#include "json_parser.h"
+#include "json_patch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void check(int condition, const char* what, const char* input)
+{
+	if (condition) return;
+	fprintf(stderr, "json_differential_check: %s\ninput: %s\n", what, input);
+	abort();
+}
+
+// Straightforward decoder, independent of the parser's validation
+static int is_valid_utf8(const unsigned char* s)
+{
+	while (*s) {
+		unsigned codepoint;
+		int continuation;
+		if (*s < 0x80) { ++s; continue; }
+		else if ((*s & 0xE0) == 0xC0) { codepoint = *s & 0x1F; continuation = 1; }
+		else if ((*s & 0xF0) == 0xE0) { codepoint = *s & 0x0F; continuation = 2; }
+		else if ((*s & 0xF8) == 0xF0) { codepoint = *s & 0x07; continuation = 3; }
+		else return 0;
+		++s;
+		for (int i = 0; i < continuation; ++i, ++s) {
+			if ((*s & 0xC0) != 0x80) return 0;
+			codepoint = (codepoint << 6) | (*s & 0x3F);
+		}
+		unsigned minimum[] = { 0, 0x80, 0x800, 0x10000 };
+		if (codepoint < minimum[continuation] || codepoint > 0x10FFFF) return 0;
+		if (codepoint >= 0xD800 && codepoint <= 0xDFFF) return 0;
+	}
+	return 1;
+}
+
+// Serialization of a successful parse, NULL if the parse failed
+static char* parse_with_options(const char* input, const json_parse_options* options)
+{
+	json_value root = { .type = JSON_TYPE_NULL };
+	if (!json_parse_ex(input, &root, options)) {
+		check(root.type == JSON_TYPE_NULL, "failed parse left a value", input);
+		return NULL;
+	}
+	char* text = json_serialize(&root);
+	json_free_value(&root);
+	return text;
+}
+
+static char* parse_reference(const char* input)
+{
+	return parse_with_options(input, NULL);
+}
+
+// Filter a fully parsed tree the slow way
+static void apply_projection(json_value* value, const json_projection* projection)
+{
+	if (projection->keep_all || (value->type != JSON_TYPE_ARRAY && value->type != JSON_TYPE_OBJECT)) return;
+
+	json_value* items = (json_value*)value->value.array.data;
+	if (value->type == JSON_TYPE_ARRAY) {
+		for (size_t i = 0; i < value->value.array.size; ++i) apply_projection(&items[i], projection);
+		return;
+	}
+
+	size_t kept = 0;
+	for (size_t i = 0; i < value->value.object.size; i += 2) {
+		const json_projection* member = NULL;
+		const json_projection* children = (const json_projection*)projection->children.data;
+		for (size_t j = 0; j < projection->children.size; ++j) {
+			if (strcmp(children[j].key, items[i].value.string) == 0) member = &children[j];
+		}
+		if (member) {
+			apply_projection(&items[i + 1], member);
+			items[kept++] = items[i];
+			items[kept++] = items[i + 1];
+		}
+		else {
+			json_free_value(&items[i]);
+			json_free_value(&items[i + 1]);
+		}
+	}
+	value->value.object.size = kept;
+}
+
+static char* parse_projected_reference(const char* input, const json_projection* projection)
+{
+	json_value root = { .type = JSON_TYPE_NULL };
+	if (!json_parse(input, &root)) return NULL;
+	apply_projection(&root, projection);
+	char* text = json_serialize(&root);
+	json_free_value(&root);
+	return text;
+}
+
+static char* parse_incremental(const char* input, size_t size, size_t chunk)
+{
+	json_parser parser;
+	json_parser_init(&parser);
+	int status = JSON_PARSER_NEED_MORE;
+	for (size_t i = 0; i < size && status != JSON_PARSER_ERROR; i += chunk) {
+		status = json_parser_feed(&parser, input + i, (size - i < chunk) ? size - i : chunk);
+	}
+	json_parser_feed(&parser, NULL, 0);
+
+	char* text = NULL;
+	json_value root;
+	if (json_parser_result(&parser, &root)) {
+		text = json_serialize(&root);
+		json_free_value(&root);
+	}
+	json_parser_free(&parser);
+	return text;
+}
+
+static char* parse_document(json_document* doc, const char* input)
+{
+	if (!json_document_parse(doc, input)) {
+		check(doc->root.type == JSON_TYPE_NULL, "failed document parse left a value", input);
+		return NULL;
+	}
+	return json_serialize(&doc->root);
+}
+
+static void check_same(const char* reference, char* other, const char* what, const char* input)
+{
+	if (reference == NULL) check(other == NULL, what, input);
+	else check(other != NULL && strcmp(reference, other) == 0, what, input);
+	free(other);
+}
+
+// A clone must equal and hash like the original, lazy numbers included
+static void check_clone(const char* input, const char* reference)
+{
+	json_parse_options lazy = { .flags = JSON_PARSE_LAZY_NUMBERS };
+	json_value root = { .type = JSON_TYPE_NULL };
+	json_value copy;
+	check(json_parse_ex(input, &root, &lazy), "clone, parse", input);
+	json_clone(&copy, &root);
+	check(json_equal(&root, &copy) && json_hash(&root) == json_hash(&copy), "clone, equality", input);
+	char* text = json_serialize(&copy);
+	check_same(reference, parse_reference(text), "clone, serialization", input);
+	free(text);
+	json_free_value(&copy);
+
+	json_value reparsed = { .type = JSON_TYPE_NULL };
+	check(json_parse(reference, &reparsed), "clone, reparse", input);
+	check(json_equal(&root, &reparsed) && json_hash(&root) == json_hash(&reparsed), "equality with the serialization", input);
+	json_free_value(&reparsed);
+	json_free_value(&root);
+}
+
+// Indexed lookups find the same member as the scan, including with duplicate keys
+static void check_lookups(const json_value* plain, const json_value* frozen, const char* input)
+{
+	if (plain->type != JSON_TYPE_ARRAY && plain->type != JSON_TYPE_OBJECT) return;
+	const json_value* items = (const json_value*)plain->value.array.data;
+	const json_value* frozen_items = (const json_value*)frozen->value.array.data;
+	for (size_t i = 0; i < plain->value.array.size; ++i) {
+		if (plain->type == JSON_TYPE_OBJECT && i % 2 == 0) {
+			const char* key = items[i].value.key;
+			check(json_value_with_key(frozen, key) - frozen_items == json_value_with_key(plain, key) - items,
+				"frozen lookup", input);
+		}
+		check_lookups(&items[i], &frozen_items[i], input);
+	}
+}
+
+static void check_freeze(const char* input)
+{
+	json_parse_options lazy = { .flags = JSON_PARSE_LAZY_NUMBERS };
+	json_value plain = { .type = JSON_TYPE_NULL };
+	json_value frozen;
+	check(json_parse_ex(input, &plain, &lazy), "freeze, parse", input);
+	json_clone(&frozen, &plain);
+	json_freeze(&frozen, JSON_FREEZE_INDEX, 2);
+	check(json_equal(&plain, &frozen), "freeze, equality", input);
+	check_lookups(&plain, &frozen, input);
+	json_free_value(&plain);
+	json_free_value(&frozen);
+}
+
+// Every key finds the same value in the sorted tree, restoring the order gives the input back
+static void check_sorted_lookups(const json_value* plain, const json_value* sorted, const char* input)
+{
+	if (plain->type != JSON_TYPE_ARRAY && plain->type != JSON_TYPE_OBJECT) return;
+	const json_value* items = (const json_value*)plain->value.array.data;
+	for (size_t i = 0; i < plain->value.array.size; ++i) {
+		if (plain->type == JSON_TYPE_OBJECT && i % 2 == 0) {
+			const char* key = items[i].value.key;
+			const json_value* found = json_value_with_key(sorted, key);
+			check(found && json_equal(found, json_value_with_key(plain, key)), "sorted lookup", input);
+		}
+		if (plain->type == JSON_TYPE_ARRAY) check_sorted_lookups(&items[i], json_get_at(sorted, i), input);
+		else if (i % 2 == 1 && json_value_with_key(plain, items[i - 1].value.key) == &items[i]) {
+			check_sorted_lookups(&items[i], json_value_with_key(sorted, items[i - 1].value.key), input);
+		}
+	}
+}
+
+static void check_sorted(const char* input, const char* reference)
+{
+	json_parse_options options = { .flags = JSON_PARSE_SORTED_KEYS };
+	json_value plain = { .type = JSON_TYPE_NULL };
+	json_value sorted = { .type = JSON_TYPE_NULL };
+	check(json_parse(input, &plain), "sorted, parse", input);
+	check(json_parse_ex(input, &sorted, &options), "sorted, parse sorted", input);
+	check(json_equal(&plain, &sorted), "sorted, equality", input);
+	check_sorted_lookups(&plain, &sorted, input);
+	json_restore_order(&sorted);
+	char* text = json_serialize(&sorted);
+	check_same(reference, text, "sorted, restored order", input);
+	json_free_value(&plain);
+	json_free_value(&sorted);
+}
+
+// Use the document as a JSON Patch on itself, a failed patch must leave it unchanged
+static void check_patch_rollback(const char* input)
+{
+	json_value ops = { .type = JSON_TYPE_NULL };
+	json_value target, original;
+	check(json_parse(input, &ops), "patch, parse", input);
+	json_clone(&target, &ops);
+	json_clone(&original, &ops);
+	if (!json_patch_apply(&target, &ops)) check(json_equal(&target, &original), "patch, rollback", input);
+	json_free_value(&ops);
+	json_free_value(&target);
+	json_free_value(&original);
+}
+
+static int has_duplicate_keys(const json_value* value)
+{
+	if (value->type != JSON_TYPE_ARRAY && value->type != JSON_TYPE_OBJECT) return 0;
+	const json_value* items = (const json_value*)value->value.array.data;
+	for (size_t i = 0; i < value->value.array.size; ++i) {
+		if (value->type == JSON_TYPE_OBJECT && i % 2 == 0) {
+			if (json_value_with_key(value, items[i].value.key) != &items[i + 1]) return 1;
+		}
+		else if (has_duplicate_keys(&items[i])) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void check_diff_pair(const json_value* a, const json_value* b, const char* input)
+{
+	json_value patch, target;
+	json_diff(a, b, &patch);
+	json_clone(&target, a);
+	check(json_patch_apply(&target, &patch), "diff, apply", input);
+	check(json_equal(&target, b), "diff, result", input);
+	json_free_value(&patch);
+	json_free_value(&target);
+}
+
+// A document differs from itself in nothing, the first two elements of an array are
+// diffed both ways. Of duplicated keys only the first is diffed so those are skipped
+static void check_diff(const char* input)
+{
+	json_value root, patch;
+	check(json_parse(input, &root), "diff, parse", input);
+	json_diff(&root, &root, &patch);
+	check(patch.value.array.size == 0, "diff, same document", input);
+	json_free_value(&patch);
+	if (root.type == JSON_TYPE_ARRAY && root.value.array.size >= 2 && !has_duplicate_keys(&root)) {
+		check_diff_pair(json_get_at(&root, 0), json_get_at(&root, 1), input);
+		check_diff_pair(json_get_at(&root, 1), json_get_at(&root, 0), input);
+	}
+	json_free_value(&root);
+}
+
+int json_differential_check(const char* data, size_t size)
+{
+	// json_parse works on C strings, everything after a NUL is ignored by all modes
+	const char* nul = memchr(data, '\0', size);
+	if (nul) size = nul - data;
+	char* input = malloc(size + 1);
+	memcpy(input, data, size);
+	input[size] = '\0';
+
+	char* reference = parse_reference(input);
+
+	check_same(reference, parse_incremental(input, size, size ? size : 1), "incremental parser, one chunk", input);
+	check_same(reference, parse_incremental(input, size, 1), "incremental parser, single bytes", input);
+	check_same(reference, parse_incremental(input, size, 7), "incremental parser, seven bytes", input);
+
+	// A cold and a warm document, the second parse reuses the memory of the first
+	json_document doc;
+	json_document_init(&doc);
+	check_same(reference, parse_document(&doc, input), "document, cold", input);
+	check_same(reference, parse_document(&doc, input), "document, warm", input);
+	json_document_free(&doc);
+
+	// Strict UTF-8 only differs when there are bad bytes, which outside of strings are a syntax error anyway
+	json_parse_options strict = { .flags = JSON_PARSE_STRICT_UTF8 };
+	if (is_valid_utf8((const unsigned char*)input)) {
+		check_same(reference, parse_with_options(input, &strict), "strict UTF-8, valid input", input);
+	}
+	else {
+		check_same(NULL, parse_with_options(input, &strict), "strict UTF-8, invalid input", input);
+	}
+
+	// Projection skips values without building them but has to agree with filtering afterwards
+	json_projection projection;
+	json_projection_init(&projection);
+	json_projection_add(&projection, "/a");
+	json_projection_add(&projection, "/b/c");
+	json_projection_add(&projection, "/");
+	json_projection_add(&projection, "/d/e/f");
+	json_parse_options projected = { .projection = &projection };
+	char* filtered = parse_projected_reference(input, &projection);
+	check_same(filtered, parse_with_options(input, &projected), "projection", input);
+	free(filtered);
+	json_projection_free(&projection);
+
+	// Lazy numbers serialize their source text, so compare after a round through the reference parser
+	json_parse_options lazy = { .flags = JSON_PARSE_LAZY_NUMBERS };
+	char* lazy_text = parse_with_options(input, &lazy);
+	check(!reference == !lazy_text, "lazy numbers, validity", input);
+	if (lazy_text) check_same(reference, parse_reference(lazy_text), "lazy numbers, source text", input);
+	free(lazy_text);
+
+	if (reference) {
+		check_same(reference, parse_reference(reference), "serialization round trip", input);
+		check_clone(input, reference);
+		check_patch_rollback(input);
+		check_freeze(input);
+		check_sorted(input, reference);
+		check_diff(input);
+	}
+
+	int valid = reference != NULL;
+	free(reference);
+	free(input);
+	return valid;
+}
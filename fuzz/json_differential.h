@@ -0,0 +1,11 @@
+#ifndef HS_JSON_DIFFERENTIAL_H
+#define HS_JSON_DIFFERENTIAL_H
+
+#include <stddef.h>
+
+// Parse data with every parser and mode and abort if they disagree on whether
+// it is valid or on the resulting tree. Valid documents are also checked to
+// survive a round trip through json_serialize. Returns 1 if data is valid JSON
+int json_differential_check(const char* data, size_t size);
+
+#endif
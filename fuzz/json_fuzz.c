@@ -0,0 +1,56 @@
+#include "json_differential.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// libFuzzer entry point, also usable with AFL++ and honggfuzz in persistent mode
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	json_differential_check((const char*)data, size);
+	return 0;
+}
+
+#ifndef JSON_LIBFUZZER
+
+// Standalone driver for AFL and for replaying crashes, checks each file named on
+// the command line or stdin if there are none
+static void check_stream(FILE* file)
+{
+	size_t size = 0;
+	size_t capacity = 4096;
+	char* data = malloc(capacity);
+	if (!data) abort();
+	size_t n;
+	while ((n = fread(data + size, 1, capacity - size, file)) > 0) {
+		size += n;
+		if (size == capacity) {
+			capacity *= 2;
+			char* new_data = realloc(data, capacity);
+			if (!new_data) abort();
+			data = new_data;
+		}
+	}
+	LLVMFuzzerTestOneInput((const uint8_t*)data, size);
+	free(data);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		check_stream(stdin);
+		return 0;
+	}
+	for (int i = 1; i < argc; ++i) {
+		FILE* file = fopen(argv[i], "rb");
+		if (!file) {
+			perror(argv[i]);
+			return 1;
+		}
+		check_stream(file);
+		fclose(file);
+	}
+	return 0;
+}
+
+#endif
@@ -1,45 +1,211 @@
 #include "json.h"
+#include "json_internal.h"
 
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
+#include <math.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef JSON_STATS
+#include <time.h>
+#endif
+#ifdef JSON_THREADS
+#include <pthread.h>
+#endif
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define JSON_SSE2
+#endif
+
+// State shared by all the parse functions during one json_parse call
+typedef struct {
+	size_t depth;
+	json_parse_options options;
+	const json_projection* projection; // Members to keep at the current level, NULL keeps all
+	json_document* doc; // Source of recycled memory, may be NULL
+#ifdef JSON_STATS
+	json_parse_stats stats;
+#endif
+} json_parse_context;
+
+#ifdef JSON_STATS
+#define JSON_STAT_ADD(ctx, field, n) ((ctx)->stats.field += (n))
+static uint64_t json_stats_now(void);
+static void json_stats_accumulate(const json_parse_stats* stats, uint64_t nanoseconds);
+#else
+#define JSON_STAT_ADD(ctx, field, n) ((void)(ctx))
+#endif
+
+static int json_parse_value(json_parse_context* ctx, const char** cursor, json_value* parent);
+static int json_parse_string(json_parse_context* ctx, const char** cursor, json_value* parent);
+static int json_parse_key(json_parse_context* ctx, const char** cursor, json_value* key, const json_projection** member);
+static int json_skip_value(json_parse_context* ctx, const char** cursor);
+
+// Spare string buffer kept by a json_document
+typedef struct {
+	char* data;
+	size_t capacity;
+} json_buffer;
+
+static void json_container_init(json_parse_context* ctx, vector* v)
+{
+	json_document* doc = ctx->doc;
+	if (doc && doc->next_container < doc->containers.size) {
+		*v = *(vector*)vector_get(&doc->containers, doc->next_container++);
+		v->size = 0;
+		return;
+	}
+	JSON_STAT_ADD(ctx, allocations, 1);
+	vector_init(v, sizeof(json_value));
+}
+
+static char* json_string_alloc(json_parse_context* ctx, size_t size)
+{
+	json_document* doc = ctx->doc;
+	if (doc && doc->next_string < doc->strings.size) {
+		json_buffer* buffer = vector_get(&doc->strings, doc->next_string++);
+		if (buffer->capacity >= size) return buffer->data;
+		JSON_STAT_ADD(ctx, reallocations, 1);
+		char* data = realloc(buffer->data, size);
+		if (!data) free(buffer->data);
+		buffer->data = data;
+		buffer->capacity = data ? size : 0;
+		return data;
+	}
+	JSON_STAT_ADD(ctx, allocations, 1);
+	char* data = malloc(size);
+	if (doc && data) {
+		// Remember the real size so a clear hands the whole buffer out again
+		json_buffer buffer = { data, size };
+		vector_push_back(&doc->strings, &buffer);
+		++doc->next_string;
+	}
+	return data;
+}
 
-static int json_parse_value(const char ** cursor, json_value * parent);
+static void json_container_push(json_parse_context* ctx, vector* v, json_value* value)
+{
+	JSON_STAT_ADD(ctx, reallocations, v->size == v->capacity);
+	vector_push_back(v, value);
+}
 
-static void skip_whitespace(const char** cursor)
+// Returns 0 if the document is nested deeper than JSON_MAX_DEPTH
+static int json_enter(json_parse_context* ctx)
 {
-	if (**cursor == '\0') return;
-	while (iscntrl((unsigned char)**cursor) || isspace((unsigned char)**cursor)) ++(*cursor);
+	++ctx->depth;
+#ifdef JSON_STATS
+	if (ctx->depth > ctx->stats.max_depth) ctx->stats.max_depth = ctx->depth;
+#endif
+	return ctx->depth <= JSON_MAX_DEPTH;
 }
 
-static int read_char(const char** cursor, char character)
+// json_value slots taken by the input positions stored behind the members of a sorted object
+static size_t json_source_slots(size_t members)
 {
-	skip_whitespace(cursor);
-	int success = **cursor == character;
-	if (success) ++(*cursor);
-	return success;
+	return (members * sizeof(uint32_t) + sizeof(json_value) - 1) / sizeof(json_value);
+}
+
+// Make room for one more member of an object that gets sorted, along with the input
+// positions of all members, so json_sort_members doesn't have to grow it again
+static void json_reserve_sorted_member(json_parse_context* ctx, vector* members)
+{
+	size_t needed = members->size + 2 + json_source_slots(members->size / 2 + 1);
+	if (needed <= members->capacity) return;
+	JSON_STAT_ADD(ctx, reallocations, 1);
+	vector_reserve(members, needed > members->capacity * 2 ? needed : members->capacity * 2);
 }
 
-static int json_parse_object(const char** cursor, json_value* parent)
+typedef struct {
+	const char* key;
+	uint32_t position;
+} json_sort_entry;
+
+static int json_sort_entry_compare(const void* a, const void* b)
+{
+	const json_sort_entry* left = a;
+	const json_sort_entry* right = b;
+	int order = strcmp(left->key, right->key);
+	if (order != 0) return order;
+	return (left->position > right->position) - (left->position < right->position);
+}
+
+// Sort the members by key and store where each one came from behind them
+static void json_sort_members(json_parse_context* ctx, json_value* object)
+{
+	vector* members = &object->value.object;
+	size_t count = members->size / 2;
+	if (count >= UINT32_MAX) return;
+	object->flags |= JSON_FLAG_SORTED_KEYS;
+	if (count == 0) return;
+
+	// Only grows objects that weren't filled through json_reserve_sorted_member
+	JSON_STAT_ADD(ctx, reallocations, members->capacity < members->size + json_source_slots(count));
+	vector_reserve(members, members->size + json_source_slots(count));
+	json_value* items = (json_value*)members->data;
+	uint32_t* positions = (uint32_t*)(members->data + members->size * sizeof(json_value));
+
+	json_sort_entry* entries = malloc(count * sizeof(json_sort_entry));
+	if (!entries) abort();
+	int sorted = 1;
+	for (size_t i = 0; i < count; ++i) {
+		entries[i].key = items[i * 2].value.key;
+		entries[i].position = (uint32_t)i;
+		sorted = sorted && (i == 0 || strcmp(entries[i - 1].key, entries[i].key) <= 0);
+	}
+	if (!sorted) {
+		qsort(entries, count, sizeof(json_sort_entry), json_sort_entry_compare);
+		json_value* unsorted = malloc(members->size * sizeof(json_value));
+		if (!unsorted) abort();
+		memcpy(unsorted, items, members->size * sizeof(json_value));
+		for (size_t i = 0; i < count; ++i) {
+			items[i * 2] = unsorted[entries[i].position * 2];
+			items[i * 2 + 1] = unsorted[entries[i].position * 2 + 1];
+		}
+		free(unsorted);
+	}
+	for (size_t i = 0; i < count; ++i) positions[i] = entries[i].position;
+	free(entries);
+}
+
+static int json_parse_object(json_parse_context* ctx, const char** cursor, json_value* parent)
 {
 	json_value result = { .type = JSON_TYPE_OBJECT };
-	vector_init(&result.value.object, sizeof(json_value));
+	json_container_init(ctx, &result.value.object);
+
+	int success = json_enter(ctx);
+	if (success && read_char(cursor, '}')) {
+		--ctx->depth;
+		if (ctx->options.flags & JSON_PARSE_SORTED_KEYS) result.flags |= JSON_FLAG_SORTED_KEYS;
+		*parent = result;
+		return success;
+	}
 
-	int success = 1;
-	while (success && !read_char(cursor, '}')) {
+	const json_projection* projection = ctx->projection;
+	while (success) {
 		json_value key = { .type = JSON_TYPE_NULL };
 		json_value value = { .type = JSON_TYPE_NULL };
-		success = json_parse_value(cursor, &key) && key.type == JSON_TYPE_STRING;
+		const json_projection* member = NULL;
+		success = json_parse_key(ctx, cursor, &key, &member);
 		success = success && read_char(cursor, ':');
-		success = success && json_parse_value(cursor, &value);
-
-		if (success) {
-			vector_push_back(&result.value.object, &key);
-			vector_push_back(&result.value.object, &value);
+		if (success && key.type != JSON_TYPE_STRING) {
+			// Not part of the projection
+			success = json_skip_value(ctx, cursor);
 		}
-		else {
+		else if (success) {
+			ctx->projection = (member && !member->keep_all) ? member : NULL;
+			success = json_parse_value(ctx, cursor, &value);
+			ctx->projection = projection;
+			if (success) {
+				if (ctx->options.flags & JSON_PARSE_SORTED_KEYS) json_reserve_sorted_member(ctx, &result.value.object);
+				json_container_push(ctx, &result.value.object, &key);
+				json_container_push(ctx, &result.value.object, &value);
+			}
+		}
+
+		if (!success) {
 			json_free_value(&key);
 			break;
 		}
@@ -48,8 +214,10 @@ static int json_parse_object(const char** cursor, json_value* parent)
 		else if (read_char(cursor, ',')) continue;
 		else success = 0;
 	}
+	--ctx->depth;
 
 	if (success) {
+		if (ctx->options.flags & JSON_PARSE_SORTED_KEYS) json_sort_members(ctx, &result);
 		*parent = result;
 	}
 	else {
@@ -59,103 +227,470 @@ static int json_parse_object(const char** cursor, json_value* parent)
 	return success;
 }
 
-static int json_parse_array(const char** cursor, json_value* parent)
+static int json_parse_array(json_parse_context* ctx, const char** cursor, json_value* parent)
 {
 	parent->type = JSON_TYPE_ARRAY;
-	vector_init(&parent->value.array, sizeof(json_value));
-	int success = 1;
+	json_container_init(ctx, &parent->value.array);
+	int success = json_enter(ctx);
 
-	if (**cursor == ']') {
+	if (success && **cursor == ']') {
 		++(*cursor);
+		--ctx->depth;
 		return success;
 	}
 
 	while (success) {
 		json_value new_value = { .type = JSON_TYPE_NULL };
-		success = json_parse_value(cursor, &new_value);
+		success = json_parse_value(ctx, cursor, &new_value);
 		if (!success) break;
 		skip_whitespace(cursor);
-		vector_push_back(&parent->value.array, &new_value);
+		json_container_push(ctx, &parent->value.array, &new_value);
 		skip_whitespace(cursor);
 		if (read_char(cursor, ']')) break;
 		else if (read_char(cursor, ',')) continue;
 		else success = 0;
 	}
+	--ctx->depth;
 
 	if (!success) {
-		parent->type = JSON_TYPE_NULL;
-		vector_free(&parent->value.array);
+		json_free_value(parent);
 	}
 
 	return success;
 }
 
-static int json_parse_string(const char** cursor, json_value* parent)
+size_t json_number_length(const char* s)
 {
-	int success = 1;
-	const char* start = *cursor;
-	char* end = strchr(start, '"');
-	// Find actual string length
-	while (end != NULL && *(end - 1) == '\\')
-	{
-		start = end + 1;
-		end = strchr(start, '"');
+	const char* p = s;
+	if (*p == '-') ++p;
+	if (*p == '0') {
+		++p;
+	}
+	else if (*p >= '1' && *p <= '9') {
+		while (isdigit((unsigned char)*p)) ++p;
+	}
+	else {
+		return 0;
+	}
+	if (*p == '.') {
+		++p;
+		if (!isdigit((unsigned char)*p)) return 0;
+		while (isdigit((unsigned char)*p)) ++p;
+	}
+	if (*p == 'e' || *p == 'E') {
+		++p;
+		if (*p == '+' || *p == '-') ++p;
+		if (!isdigit((unsigned char)*p)) return 0;
+		while (isdigit((unsigned char)*p)) ++p;
+	}
+	return p - s;
+}
+
+size_t json_utf8_encode(unsigned codepoint, char* out)
+{
+	if (codepoint < 0x80) {
+		out[0] = (char)codepoint;
+		return 1;
+	}
+	if (codepoint < 0x800) {
+		out[0] = (char)(0xC0 | (codepoint >> 6));
+		out[1] = (char)(0x80 | (codepoint & 0x3F));
+		return 2;
+	}
+	if (codepoint < 0x10000) {
+		out[0] = (char)(0xE0 | (codepoint >> 12));
+		out[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+		out[2] = (char)(0x80 | (codepoint & 0x3F));
+		return 3;
+	}
+	out[0] = (char)(0xF0 | (codepoint >> 18));
+	out[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+	out[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+	out[3] = (char)(0x80 | (codepoint & 0x3F));
+	return 4;
+}
+
+// Length of the well formed UTF-8 sequence at s, which starts with a non ASCII byte,
+// 0 if it is invalid. Ranges as in the table of RFC 3629 section 4, this rejects
+// overlong forms, surrogates and anything above U+10FFFF. Stops at the first bad
+// byte so it never reads past a terminating NUL
+static size_t json_utf8_sequence_length(const unsigned char* s)
+{
+	unsigned char lead = s[0];
+	if (lead >= 0xC2 && lead <= 0xDF) {
+		return (s[1] & 0xC0) == 0x80 ? 2 : 0;
+	}
+	if (lead >= 0xE0 && lead <= 0xEF) {
+		unsigned char low = (lead == 0xE0) ? 0xA0 : 0x80;
+		unsigned char high = (lead == 0xED) ? 0x9F : 0xBF;
+		if (s[1] < low || s[1] > high || (s[2] & 0xC0) != 0x80) return 0;
+		return 3;
+	}
+	if (lead >= 0xF0 && lead <= 0xF4) {
+		unsigned char low = (lead == 0xF0) ? 0x90 : 0x80;
+		unsigned char high = (lead == 0xF4) ? 0x8F : 0xBF;
+		if (s[1] < low || s[1] > high || (s[2] & 0xC0) != 0x80 || (s[3] & 0xC0) != 0x80) return 0;
+		return 4;
+	}
+	return 0;
+}
+
+#ifdef JSON_SSE2
+// Bit per byte of the 16 at p that the scalar loop has to look at: quotes,
+// backslashes, control characters and, when validating, non ASCII bytes. p is 16 byte
+// aligned so the load stays within one page, even where it reads past the input's
+// terminating NUL. That is fine for the hardware but not for the sanitizers
+__attribute__((no_sanitize_address, no_sanitize_thread))
+static inline unsigned json_string_special_mask(const char* p, int non_ascii)
+{
+	__m128i block = _mm_load_si128((const __m128i*)p);
+	__m128i quote = _mm_cmpeq_epi8(block, _mm_set1_epi8('"'));
+	__m128i backslash = _mm_cmpeq_epi8(block, _mm_set1_epi8('\\'));
+	// Signed compare, bytes >= 0x80 are negative and end up in here as well
+	__m128i low = _mm_cmplt_epi8(block, _mm_set1_epi8(0x20));
+	unsigned mask = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(quote, backslash), low));
+	if (!non_ascii) mask &= ~(unsigned)_mm_movemask_epi8(block);
+	return mask;
+}
+#endif
+
+// Find the closing quote, NULL if the string is unterminated, has raw control characters
+// or in strict mode is not valid UTF-8. Sets has_escape if there is a backslash
+static const char* json_string_end(json_parse_context* ctx, const char* source, int* has_escape)
+{
+	int strict = ctx->options.flags & JSON_PARSE_STRICT_UTF8;
+	for (;;) {
+#ifdef JSON_SSE2
+		// Skip ordinary characters 16 at a time. The terminating NUL is a control character,
+		// so the scan stops in the block that holds it and never needs the input's length
+		const char* block = (const char*)((uintptr_t)source & ~(uintptr_t)15);
+		unsigned mask = json_string_special_mask(block, strict) & (~0u << (source - block));
+		while (!mask) {
+			block += 16;
+			mask = json_string_special_mask(block, strict);
+		}
+		source = block + __builtin_ctz(mask);
+#endif
+		unsigned char c = (unsigned char)*source;
+		if (c == '"') return source;
+		if (c < 0x20) return NULL;
+		if (c == '\\') {
+			*has_escape = 1;
+			if (*++source == '\0') return NULL;
+			++source;
+		}
+		else if (c >= 0x80 && strict) {
+			size_t len = json_utf8_sequence_length((const unsigned char*)source);
+			if (!len) return NULL;
+			source += len;
+		}
+		else {
+			++source;
+		}
+	}
+}
+
+static int read_hex4(const char* source, const char* end, unsigned* codepoint)
+{
+	if (end - source < 4) return 0;
+	*codepoint = 0;
+	for (int i = 0; i < 4; ++i) {
+		int digit = json_hex_value(source[i]);
+		if (digit < 0) return 0;
+		*codepoint = (*codepoint << 4) | (unsigned)digit;
+	}
+	return 1;
+}
+
+// Decode the digits after \u including a following low surrogate, the UTF-8 is never
+// longer than the escape so it fits into the buffer sized for the raw string. \u0000
+// is rejected, strings are NUL terminated and would silently end there
+static int json_decode_unicode(const char** source, const char* end, char** target)
+{
+	unsigned codepoint;
+	if (!read_hex4(*source, end, &codepoint) || codepoint == 0) return 0;
+	*source += 4;
+	if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+		unsigned low;
+		if (end - *source < 2 || (*source)[0] != '\\' || (*source)[1] != 'u') return 0;
+		if (!read_hex4(*source + 2, end, &low) || low < 0xDC00 || low > 0xDFFF) return 0;
+		*source += 6;
+		codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
 	}
+	else if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+		return 0;
+	}
+	*target += json_utf8_encode(codepoint, *target);
+	return 1;
+}
 
-	start = *cursor;
-	char* new_string = NULL;
+// Decode the characters between source and end into target, which needs room for
+// end - source bytes. Returns the end of the decoded characters, NULL on a bad escape
+static char* json_unescape(const char* source, const char* end, char* target)
+{
+	while (source != end)
+	{
+		if (*source != '\\') {
+			*target++ = *source++;
+			continue;
+		}
+		++source;
+		switch (*source++) {
+			case '"':
+			case '\\':
+			case '/':
+				*target++ = source[-1];
+				break;
+			case 'b':
+				*target++ = '\b';
+				break;
+			case 'f':
+				*target++ = '\f';
+				break;
+			case 'n':
+				*target++ = '\n';
+				break;
+			case 'r':
+				*target++ = '\r';
+				break;
+			case 't':
+				*target++ = '\t';
+				break;
+			case 'u':
+				if (!json_decode_unicode(&source, end, &target)) return NULL;
+				break;
+			default:
+				return NULL;
+		}
+	}
+	return target;
+}
 
+static int json_parse_string(json_parse_context* ctx, const char** cursor, json_value* parent)
+{
+	int has_escape = 0;
+	const char* end = json_string_end(ctx, *cursor, &has_escape);
 	if (!end) return 0;
 
-	size_t len = end - start;
-	new_string = malloc((len + 1) * sizeof(char));
+	size_t len = end - *cursor;
+	char* new_string = json_string_alloc(ctx, (len + 1) * sizeof(char));
 	if (!new_string) return 0;
 
 	char* target = new_string;
-	const char* source = *cursor;
+	if (has_escape) {
+		target = json_unescape(*cursor, end, new_string);
+	}
+	else {
+		memcpy(target, *cursor, len);
+		target += len;
+	}
 
-	while (success && source != end)
-	{
-		if (*source == '\\') {
-			source++;
-			switch (*source) {
-				case '"':
-				case '\\':
-				case '/':
-				case '\b':
-				case '\f':
-				case '\n':
-				case '\r':
-				case '\t':
-					*target++ = *source++;
-					break;
-				case 'u':
-					break;
-				default:
-					success = 0;
-					break;
-			}
+	if (!target) {
+		free(new_string);
+		return 0;
+	}
+
+	parent->type = JSON_TYPE_STRING;
+	parent->value.string = new_string;
+	*cursor = end + 1;
+	*target = '\0';
+	JSON_STAT_ADD(ctx, string_bytes, target - new_string);
+	return 1;
+}
+
+int json_decode_string(const char** cursor, vector* out)
+{
+	json_parse_context ctx = { .depth = 0 };
+	int has_escape = 0;
+	const char* end = json_string_end(&ctx, *cursor, &has_escape);
+	if (!end) return 0;
+
+	size_t len = end - *cursor;
+	vector_reserve(out, out->size + len + 1);
+	char* start = vector_get(out, out->size);
+	char* target = has_escape ? json_unescape(*cursor, end, start) : (char*)memcpy(start, *cursor, len) + len;
+	if (!target) return 0;
+	*target = '\0';
+	out->size += target - start + 1;
+	*cursor = end + 1;
+	return 1;
+}
+
+
+static const json_projection* json_projection_find(const json_projection* projection, const char* key, size_t len)
+{
+	const json_projection* children = (const json_projection*)projection->children.data;
+	for (size_t i = 0; i < projection->children.size; ++i) {
+		if (children[i].key_length == len && memcmp(children[i].key, key, len) == 0) return &children[i];
+	}
+	return NULL;
+}
+
+// Parse an object key, with a projection the key is only materialized if it is
+// selected, otherwise key is left as null. member is the matching projection entry
+static int json_parse_key(json_parse_context* ctx, const char** cursor, json_value* key, const json_projection** member)
+{
+	if (!read_char(cursor, '"')) return 0;
+	if (!ctx->projection) {
+		int success = json_parse_string(ctx, cursor, key);
+		JSON_STAT_ADD(ctx, values[JSON_TYPE_STRING], success);
+		return success;
+	}
+
+	int has_escape = 0;
+	const char* end = json_string_end(ctx, *cursor, &has_escape);
+	if (!end) return 0;
+	if (has_escape) {
+		// Rare, compare the decoded key
+		if (!json_parse_string(ctx, cursor, key)) return 0;
+		*member = json_projection_find(ctx->projection, key->value.string, strlen(key->value.string));
+		if (!*member) json_free_value(key);
+	}
+	else {
+		*member = json_projection_find(ctx->projection, *cursor, end - *cursor);
+		if (*member) return json_parse_string(ctx, cursor, key);
+		*cursor = end + 1;
+	}
+	if (*member) JSON_STAT_ADD(ctx, values[JSON_TYPE_STRING], 1);
+	return 1;
+}
+
+// Check the escapes between source and end the same way json_parse_string decodes them
+static int json_validate_escapes(const char* source, const char* end)
+{
+	while (source != end) {
+		if (*source++ != '\\') continue;
+		char c = *source++;
+		if (c == 'u') {
+			char buffer[4];
+			char* target = buffer;
+			if (!json_decode_unicode(&source, end, &target)) return 0;
 		}
-		else {
-			*target++ = *source++;
+		else if (!strchr("\"\\/bfnrt", c)) {
+			return 0;
 		}
 	}
+	return 1;
+}
 
-	if (success)
-	{
-		parent->type = JSON_TYPE_STRING;
-		parent->value.string = new_string;
+// Check and step over a value without building anything, accepts exactly what json_parse_value does
+static int json_skip_value(json_parse_context* ctx, const char** cursor)
+{
+	skip_whitespace(cursor);
+	char c = **cursor;
+	if (c == '"') {
+		int has_escape = 0;
+		const char* start = *cursor + 1;
+		const char* end = json_string_end(ctx, start, &has_escape);
+		if (!end || (has_escape && !json_validate_escapes(start, end))) return 0;
 		*cursor = end + 1;
-		*target = '\0';
+		return 1;
 	}
-	else
-	{
-		free(new_string);
+	if (c == '{' || c == '[') {
+		char close = (c == '{') ? '}' : ']';
+		++(*cursor);
+		int success = json_enter(ctx);
+		if (success && read_char(cursor, close)) {
+			--ctx->depth;
+			return 1;
+		}
+		while (success) {
+			if (c == '{') {
+				int has_escape = 0;
+				success = read_char(cursor, '"');
+				const char* end = success ? json_string_end(ctx, *cursor, &has_escape) : NULL;
+				success = end && (!has_escape || json_validate_escapes(*cursor, end));
+				if (success) *cursor = end + 1;
+				success = success && read_char(cursor, ':');
+			}
+			success = success && json_skip_value(ctx, cursor);
+			if (!success || read_char(cursor, close)) break;
+			success = read_char(cursor, ',');
+		}
+		--ctx->depth;
+		return success;
 	}
+	if (c == 't') return read_literal(cursor, "true");
+	if (c == 'f') return read_literal(cursor, "false");
+	if (c == 'n') return read_literal(cursor, "null");
 
-	return success;
+	size_t len = json_number_length(*cursor);
+	*cursor += len;
+	return len != 0;
+}
+
+void json_projection_init(json_projection* projection)
+{
+	projection->key = NULL;
+	projection->key_length = 0;
+	projection->keep_all = 0;
+	vector_init(&projection->children, sizeof(json_projection));
 }
 
+void json_projection_free(json_projection* projection)
+{
+	if (!projection) return;
+	vector_foreach(&projection->children, (void(*)(void*))json_projection_free);
+	vector_free(&projection->children);
+	free(projection->key);
+	projection->key = NULL;
+}
+
+int json_projection_add(json_projection* projection, const char* path)
+{
+	if (*path != '\0' && *path != '/') return 0;
+
+	// Decode into a scratch buffer first so a malformed path changes nothing
+	size_t len = strlen(path);
+	char* tokens = malloc(len + 1);
+	if (!tokens) return 0;
+	char* target = tokens;
+	for (const char* c = path; *c; ++c) {
+		if (*c == '/') {
+			*target++ = '\0';
+		}
+		else if (*c == '~' && (c[1] == '0' || c[1] == '1')) {
+			*target++ = (*++c == '0') ? '~' : '/';
+		}
+		else if (*c == '~') {
+			free(tokens);
+			return 0;
+		}
+		else {
+			*target++ = *c;
+		}
+	}
+	*target = '\0';
+	const char* tokens_end = target;
+
+	// Each token is preceded by its terminator from the '/'
+	json_projection* node = projection;
+	for (const char* token = tokens; token != tokens_end && !node->keep_all; ) {
+		++token;
+		size_t token_len = strlen(token);
+		json_projection* child = (json_projection*)json_projection_find(node, token, token_len);
+		if (!child) {
+			json_projection new_child;
+			json_projection_init(&new_child);
+			new_child.key = malloc(token_len + 1);
+			memcpy(new_child.key, token, token_len + 1);
+			new_child.key_length = token_len;
+			vector_push_back(&node->children, &new_child);
+			child = vector_get(&node->children, node->children.size - 1);
+		}
+		node = child;
+		token += token_len;
+	}
+
+	if (!node->keep_all) {
+		// Everything below is selected now
+		vector_foreach(&node->children, (void(*)(void*))json_projection_free);
+		node->children.size = 0;
+		node->keep_all = 1;
+	}
+	free(tokens);
+	return 1;
+}
 
 void json_free_value(json_value* val)
 {
@@ -174,19 +709,13 @@ void json_free_value(json_value* val)
 	}
 
 	val->type = JSON_TYPE_NULL;
+	val->flags = 0;
 }
 
-static int read_literal(const char** cursor, const char* literal) {
-	size_t cnt = strlen(literal);
-	if (strncmp(*cursor, literal, cnt) == 0) {
-		*cursor += cnt;
-		return 1;
-	}
-	return 0;
-}
-
-static int json_parse_value(const char** cursor, json_value* parent)
+static int json_parse_value(json_parse_context* ctx, const char** cursor, json_value* parent)
 {
+	// parent may be uninitialized, only numbers and objects set flags of their own
+	parent->flags = 0;
 	// Eat whitespace
 	int success = 0;
 	skip_whitespace(cursor);
@@ -198,17 +727,17 @@ static int json_parse_value(const char** cursor, json_value* parent)
 			break;
 		case '"':
 			++*cursor;
-			success = json_parse_string(cursor, parent);
+			success = json_parse_string(ctx, cursor, parent);
 			break;
 		case '{':
 			++(*cursor);
 			skip_whitespace(cursor);
-			success = json_parse_object(cursor, parent);
+			success = json_parse_object(ctx, cursor, parent);
 			break;
 		case '[':
 			++(*cursor);
 			skip_whitespace(cursor);
-			success = json_parse_array(cursor, parent);
+			success = json_parse_array(ctx, cursor, parent);
 			break;
 		case 't': {
 			success = read_literal(cursor, "true");
@@ -228,35 +757,263 @@ static int json_parse_value(const char** cursor, json_value* parent)
 		}
 		case 'n':
 			success = read_literal(cursor, "null");
+			if (success) parent->type = JSON_TYPE_NULL;
 			break;
 		default: {
-			char* end;
-			double number = strtod(*cursor, &end);
-			if (*cursor != end) {
+			size_t len = json_number_length(*cursor);
+			if (len) {
 				parent->type = JSON_TYPE_NUMBER;
-				parent->value.number = number;
-				*cursor = end;
+				if (ctx->options.flags & JSON_PARSE_LAZY_NUMBERS) {
+					parent->flags = JSON_FLAG_NUMBER_TEXT | JSON_FLAG_NUMBER_PENDING;
+					parent->value.raw.text = *cursor;
+					parent->value.raw.length = len;
+				}
+				else {
+					parent->value.number = strtod(*cursor, NULL);
+				}
+				*cursor += len;
 				success = 1;
 			}
 		}
 	}
 
+	JSON_STAT_ADD(ctx, values[parent->type], success);
 	return success;
 }
 
-int json_parse(const char* input, json_value* result)
+// Start at the root of the projection unless the whole document is selected
+static void json_projection_apply(json_parse_context* ctx)
+{
+	const json_projection* projection = ctx->options.projection;
+	ctx->projection = (projection && !projection->keep_all) ? projection : NULL;
+}
+
+static int json_parse_root(json_parse_context* ctx, const char* input, json_value* result)
 {
-	const char** cursor = &input;
-	int success = json_parse_value(cursor, result);
+	const char* position = input;
+	const char** cursor = &position;
+#ifdef JSON_STATS
+	uint64_t start_nanoseconds = json_stats_now();
+#endif
+	int success = json_parse_value(ctx, cursor, result);
 	skip_whitespace(cursor);
 	if (**cursor != '\0')
 	{
 		success = 0;
 		json_free_value(result);
 	}
+	JSON_STAT_ADD(ctx, bytes, position - input);
+#ifdef JSON_STATS
+	uint64_t nanoseconds = json_stats_now() - start_nanoseconds;
+	ctx->stats.parse_seconds = nanoseconds / 1e9;
+	json_stats_accumulate(&ctx->stats, nanoseconds);
+#endif
 	return success;
 }
 
+int json_parse(const char* input, json_value* result)
+{
+	json_parse_context ctx = { .depth = 0 };
+	return json_parse_root(&ctx, input, result);
+}
+
+int json_parse_ex(const char* input, json_value* result, const json_parse_options* options)
+{
+	json_parse_context ctx = { .depth = 0 };
+	if (options) ctx.options = *options;
+	json_projection_apply(&ctx);
+	return json_parse_root(&ctx, input, result);
+}
+
+void json_document_init(json_document* doc)
+{
+	doc->root.type = JSON_TYPE_NULL;
+	doc->root.flags = 0;
+	vector_init(&doc->containers, sizeof(vector));
+	vector_init(&doc->strings, sizeof(json_buffer));
+	vector_init(&doc->containers_scratch, sizeof(vector));
+	vector_init(&doc->strings_scratch, sizeof(json_buffer));
+	doc->next_container = 0;
+	doc->next_string = 0;
+}
+
+// Collect the memory of val in the order a parse of the same document would ask for it
+static void json_document_harvest(json_document* doc, json_value* val)
+{
+	switch (val->type) {
+		case JSON_TYPE_STRING: {
+			// Strings come back in the order they were handed out, unless the tree was changed
+			size_t index = doc->strings_scratch.size;
+			json_buffer buffer = { val->value.string, strlen(val->value.string) + 1 };
+			if (index < doc->next_string) {
+				json_buffer* given = vector_get(&doc->strings, index);
+				if (given->data == buffer.data) buffer.capacity = given->capacity;
+			}
+			vector_push_back(&doc->strings_scratch, &buffer);
+			break;
+		}
+		case JSON_TYPE_ARRAY:
+		case JSON_TYPE_OBJECT: {
+			vector container = val->value.array;
+			container.size = 0;
+			vector_push_back(&doc->containers_scratch, &container);
+			json_value* items = (json_value*)val->value.array.data;
+			for (size_t i = 0; i < val->value.array.size; ++i) {
+				json_document_harvest(doc, &items[i]);
+			}
+			break;
+		}
+	}
+	val->type = JSON_TYPE_NULL;
+	val->flags = 0;
+}
+
+void json_document_clear(json_document* doc)
+{
+	json_document_harvest(doc, &doc->root);
+
+	// Whatever the last parse didn't use goes after the harvested memory
+	vector_append(&doc->containers_scratch, vector_get(&doc->containers, doc->next_container),
+		doc->containers.size - doc->next_container);
+	vector_append(&doc->strings_scratch, vector_get(&doc->strings, doc->next_string),
+		doc->strings.size - doc->next_string);
+
+	vector swap = doc->containers;
+	doc->containers = doc->containers_scratch;
+	doc->containers_scratch = swap;
+	doc->containers_scratch.size = 0;
+	swap = doc->strings;
+	doc->strings = doc->strings_scratch;
+	doc->strings_scratch = swap;
+	doc->strings_scratch.size = 0;
+
+	doc->next_container = 0;
+	doc->next_string = 0;
+}
+
+int json_document_parse(json_document* doc, const char* input)
+{
+	return json_document_parse_ex(doc, input, NULL);
+}
+
+int json_document_parse_ex(json_document* doc, const char* input, const json_parse_options* options)
+{
+	json_document_clear(doc);
+	json_parse_context ctx = { .depth = 0, .doc = doc };
+	if (options) ctx.options = *options;
+	json_projection_apply(&ctx);
+	return json_parse_root(&ctx, input, &doc->root);
+}
+
+void json_document_free(json_document* doc)
+{
+	if (!doc) return;
+	json_free_value(&doc->root);
+	for (size_t i = doc->next_container; i < doc->containers.size; ++i) {
+		vector_free(vector_get(&doc->containers, i));
+	}
+	for (size_t i = doc->next_string; i < doc->strings.size; ++i) {
+		free(((json_buffer*)vector_get(&doc->strings, i))->data);
+	}
+	vector_free(&doc->containers);
+	vector_free(&doc->strings);
+	vector_free(&doc->containers_scratch);
+	vector_free(&doc->strings_scratch);
+}
+
+#ifdef JSON_STATS
+
+// Totals of all parses, time is kept in whole nanoseconds so it can be added atomically
+static struct {
+	size_t bytes;
+	size_t values[JSON_TYPE_STRING + 1];
+	size_t max_depth;
+	size_t string_bytes;
+	size_t allocations;
+	size_t reallocations;
+	uint64_t parse_nanoseconds;
+} global_stats;
+
+// GCC and clang have atomic builtins, elsewhere the totals are best effort
+#if defined(__GNUC__)
+#define JSON_STAT_GLOBAL_ADD(field, n) __atomic_fetch_add(&global_stats.field, (n), __ATOMIC_RELAXED)
+#define JSON_STAT_GLOBAL_LOAD(field) __atomic_load_n(&global_stats.field, __ATOMIC_RELAXED)
+#define JSON_STAT_GLOBAL_STORE(field, n) __atomic_store_n(&global_stats.field, (n), __ATOMIC_RELAXED)
+#else
+#define JSON_STAT_GLOBAL_ADD(field, n) (global_stats.field += (n))
+#define JSON_STAT_GLOBAL_LOAD(field) (global_stats.field)
+#define JSON_STAT_GLOBAL_STORE(field, n) (global_stats.field = (n))
+#endif
+
+// Wall time from a monotonic clock, processor time would charge concurrent parses to each other
+static uint64_t json_stats_now(void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#else
+	return (uint64_t)((double)clock() / CLOCKS_PER_SEC * 1e9);
+#endif
+}
+
+static void json_stats_accumulate(const json_parse_stats* stats, uint64_t nanoseconds)
+{
+	JSON_STAT_GLOBAL_ADD(bytes, stats->bytes);
+	for (int i = 0; i <= JSON_TYPE_STRING; ++i) {
+		JSON_STAT_GLOBAL_ADD(values[i], stats->values[i]);
+	}
+	JSON_STAT_GLOBAL_ADD(string_bytes, stats->string_bytes);
+	JSON_STAT_GLOBAL_ADD(allocations, stats->allocations);
+	JSON_STAT_GLOBAL_ADD(reallocations, stats->reallocations);
+	JSON_STAT_GLOBAL_ADD(parse_nanoseconds, nanoseconds);
+#if defined(__GNUC__)
+	size_t depth = __atomic_load_n(&global_stats.max_depth, __ATOMIC_RELAXED);
+	while (stats->max_depth > depth
+		&& !__atomic_compare_exchange_n(&global_stats.max_depth, &depth, stats->max_depth, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+#else
+	if (stats->max_depth > global_stats.max_depth) global_stats.max_depth = stats->max_depth;
+#endif
+}
+
+int json_parse_with_stats(const char* input, json_value* root, json_parse_stats* stats)
+{
+	json_parse_context ctx = { .depth = 0 };
+	int success = json_parse_root(&ctx, input, root);
+	if (stats) *stats = ctx.stats;
+	return success;
+}
+
+void json_stats_global(json_parse_stats* stats)
+{
+	// Each field is read atomically, parses finishing meanwhile may be partly included
+	stats->bytes = JSON_STAT_GLOBAL_LOAD(bytes);
+	for (int i = 0; i <= JSON_TYPE_STRING; ++i) {
+		stats->values[i] = JSON_STAT_GLOBAL_LOAD(values[i]);
+	}
+	stats->max_depth = JSON_STAT_GLOBAL_LOAD(max_depth);
+	stats->string_bytes = JSON_STAT_GLOBAL_LOAD(string_bytes);
+	stats->allocations = JSON_STAT_GLOBAL_LOAD(allocations);
+	stats->reallocations = JSON_STAT_GLOBAL_LOAD(reallocations);
+	stats->parse_seconds = JSON_STAT_GLOBAL_LOAD(parse_nanoseconds) / 1e9;
+}
+
+void json_stats_reset_global(void)
+{
+	JSON_STAT_GLOBAL_STORE(bytes, 0);
+	for (int i = 0; i <= JSON_TYPE_STRING; ++i) {
+		JSON_STAT_GLOBAL_STORE(values[i], 0);
+	}
+	JSON_STAT_GLOBAL_STORE(max_depth, 0);
+	JSON_STAT_GLOBAL_STORE(string_bytes, 0);
+	JSON_STAT_GLOBAL_STORE(allocations, 0);
+	JSON_STAT_GLOBAL_STORE(reallocations, 0);
+	JSON_STAT_GLOBAL_STORE(parse_nanoseconds, 0);
+}
+
+#endif
+
 char* json_value_to_string(json_value* value)
 {
 	assert(value->type == JSON_TYPE_STRING);
@@ -266,9 +1023,41 @@ char* json_value_to_string(json_value* value)
 double json_value_to_double(json_value* value)
 {
 	assert(value->type == JSON_TYPE_NUMBER);
+	if (value->flags & JSON_FLAG_NUMBER_PENDING) json_number_materialize(value);
 	return value->value.number;
 }
 
+double json_number_value(const json_value* value)
+{
+	if (value->flags & JSON_FLAG_NUMBER_PENDING) {
+		// The text is followed by a character that can't continue the number
+		return strtod(value->value.raw.text, NULL);
+	}
+	return value->value.number;
+}
+
+void json_number_materialize(json_value* value)
+{
+	if (!(value->flags & JSON_FLAG_NUMBER_PENDING)) return;
+	value->value.raw.value = strtod(value->value.raw.text, NULL);
+	value->flags &= ~JSON_FLAG_NUMBER_PENDING;
+}
+
+int json_number_text_int64(const json_value* value, int64_t* out)
+{
+	if (!(value->flags & JSON_FLAG_NUMBER_TEXT)) return 0;
+	const char* text = value->value.raw.text;
+	size_t len = value->value.raw.length;
+	if (memchr(text, '.', len) || memchr(text, 'e', len) || memchr(text, 'E', len)) {
+		return json_double_to_int64(json_number_value(value), out);
+	}
+	errno = 0;
+	long long integer = strtoll(text, NULL, 10);
+	if (errno == ERANGE) return 0;
+	*out = (int64_t)integer;
+	return 1;
+}
+
 int json_value_to_bool(json_value* value)
 {
 	assert(value->type == JSON_TYPE_BOOL);
@@ -290,17 +1079,77 @@ vector* json_value_to_object(json_value* value)
 json_value* json_value_at(const json_value* root, size_t index)
 {
 	assert(root->type == JSON_TYPE_ARRAY);
-	if (root->value.array.size < index) {
-		return vector_get_checked(&root->value.array,index);
+	return vector_get_checked(&root->value.array, index);
+}
+
+// Key index of a frozen object, an open addressing table stored in the same allocation
+// right after the members. Its size follows from the number of members
+typedef struct {
+	uint32_t member; // Member number + 1, 0 marks an empty slot
+	uint32_t tag; // High half of json_key_hash
+} json_key_slot;
+
+static size_t json_key_index_slots(size_t members)
+{
+	size_t slots = 1;
+	while (slots < members * 2) slots *= 2;
+	return slots;
+}
+
+static json_key_slot* json_key_index(const json_value* object)
+{
+	return (json_key_slot*)(object->value.object.data + object->value.object.size * sizeof(json_value));
+}
+
+static json_value* json_key_index_find(const json_value* object, const char* key, size_t length, uint64_t hash)
+{
+	json_value* data = (json_value*)object->value.object.data;
+	const json_key_slot* slots = json_key_index(object);
+	size_t mask = json_key_index_slots(object->value.object.size / 2) - 1;
+	uint32_t tag = (uint32_t)(hash >> 32);
+	for (size_t i = hash & mask; slots[i].member; i = (i + 1) & mask) {
+		if (slots[i].tag != tag) continue;
+		const char* candidate = data[(slots[i].member - 1) * 2].value.key;
+		if (strncmp(candidate, key, length) == 0 && candidate[length] == '\0') {
+			return &data[(slots[i].member - 1) * 2 + 1];
+		}
 	}
-	else {
-		return NULL;
+	return NULL;
+}
+
+// Compare a stored key with one that is length characters long, like strcmp
+static int json_key_compare_n(const char* stored, const char* key, size_t length)
+{
+	int order = strncmp(stored, key, length);
+	if (order != 0) return order;
+	return stored[length] != '\0';
+}
+
+// Binary search for the first member with key in a sorted object
+static json_value* json_sorted_find(const json_value* object, const char* key, size_t length)
+{
+	json_value* data = (json_value*)object->value.object.data;
+	size_t low = 0;
+	size_t high = object->value.object.size / 2;
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+		if (json_key_compare_n(data[middle * 2].value.key, key, length) < 0) low = middle + 1;
+		else high = middle;
 	}
+	if (low < object->value.object.size / 2 && json_key_compare_n(data[low * 2].value.key, key, length) == 0) {
+		return &data[low * 2 + 1];
+	}
+	return NULL;
 }
 
 json_value* json_value_with_key(const json_value* root, const char* key)
 {
 	assert(root->type == JSON_TYPE_OBJECT);
+	if (root->flags & JSON_FLAG_KEY_INDEX) {
+		size_t length = strlen(key);
+		return json_key_index_find(root, key, length, json_key_hash(key, length));
+	}
+	if (root->flags & JSON_FLAG_SORTED_KEYS) return json_sorted_find(root, key, strlen(key));
 	json_value* data = (json_value*)root->value.object.data;
 	size_t size = root->value.object.size;
 	for (size_t i = 0; i < size; i += 2)
@@ -313,17 +1162,485 @@ json_value* json_value_with_key(const json_value* root, const char* key)
 	return NULL;
 }
 
+json_value* json_value_with_key_hashed(const json_value* root, const char* key, size_t length, uint64_t hash)
+{
+	if (!root || root->type != JSON_TYPE_OBJECT) return NULL;
+	if (root->flags & JSON_FLAG_KEY_INDEX) return json_key_index_find(root, key, length, hash);
+	if (root->flags & JSON_FLAG_SORTED_KEYS) return json_sorted_find(root, key, length);
+	json_value* data = (json_value*)root->value.object.data;
+	size_t size = root->value.object.size;
+	for (size_t i = 0; i < size; i += 2)
+	{
+		const char* candidate = data[i].value.string;
+		if (strncmp(candidate, key, length) == 0 && candidate[length] == '\0')
+		{
+			return &data[i + 1];
+		}
+	}
+	return NULL;
+}
+
+void json_restore_order(json_value* root)
+{
+	if (root->type != JSON_TYPE_ARRAY && root->type != JSON_TYPE_OBJECT) return;
+	json_value* items = (json_value*)root->value.array.data;
+	size_t size = root->value.array.size;
+	if (root->type == JSON_TYPE_OBJECT && (root->flags & JSON_FLAG_SORTED_KEYS) && size > 0) {
+		json_value* sorted = malloc(size * sizeof(json_value));
+		if (!sorted) abort();
+		memcpy(sorted, items, size * sizeof(json_value));
+		for (size_t i = 0; i < size / 2; ++i) {
+			size_t position = json_object_source_position(root, i);
+			items[position * 2] = sorted[i * 2];
+			items[position * 2 + 1] = sorted[i * 2 + 1];
+		}
+		free(sorted);
+	}
+	root->flags &= ~(unsigned)JSON_FLAG_SORTED_KEYS;
+	for (size_t i = 0; i < size; ++i) {
+		json_restore_order(&items[i]);
+	}
+}
+
+void json_object_join_init(json_object_join* join, const json_value* a, const json_value* b)
+{
+	assert(a->type == JSON_TYPE_OBJECT && (a->flags & JSON_FLAG_SORTED_KEYS));
+	assert(b->type == JSON_TYPE_OBJECT && (b->flags & JSON_FLAG_SORTED_KEYS));
+	join->a = a;
+	join->b = b;
+	join->a_next = 0;
+	join->b_next = 0;
+}
+
+int json_object_join_next(json_object_join* join, const char** key, const json_value** a_value, const json_value** b_value)
+{
+	const json_value* a = (const json_value*)join->a->value.object.data + join->a_next;
+	const json_value* b = (const json_value*)join->b->value.object.data + join->b_next;
+	int a_left = join->a_next < join->a->value.object.size;
+	int b_left = join->b_next < join->b->value.object.size;
+	if (!a_left && !b_left) return 0;
+
+	int order = !a_left ? 1 : !b_left ? -1 : strcmp(a->value.key, b->value.key);
+	*key = order <= 0 ? a->value.key : b->value.key;
+	*a_value = NULL;
+	*b_value = NULL;
+	if (order <= 0) {
+		*a_value = a + 1;
+		join->a_next += 2;
+	}
+	if (order >= 0) {
+		*b_value = b + 1;
+		join->b_next += 2;
+	}
+	return 1;
+}
+
+static void json_write_string(vector* out, const char* string)
+{
+	vector_push_back(out, "\"");
+	const char* run = string;
+	for (const char* c = string; *c; ++c) {
+		unsigned char byte = (unsigned char)*c;
+		if (byte >= 0x20 && byte != '"' && byte != '\\') continue;
+
+		vector_append(out, run, c - run);
+		run = c + 1;
+		char escape[7] = { '\\', 0 };
+		size_t len = 2;
+		switch (byte) {
+			case '"': escape[1] = '"'; break;
+			case '\\': escape[1] = '\\'; break;
+			case '\b': escape[1] = 'b'; break;
+			case '\f': escape[1] = 'f'; break;
+			case '\n': escape[1] = 'n'; break;
+			case '\r': escape[1] = 'r'; break;
+			case '\t': escape[1] = 't'; break;
+			default:
+				len = snprintf(escape, sizeof(escape), "\\u%04x", byte);
+				break;
+		}
+		vector_append(out, escape, len);
+	}
+	vector_append(out, run, strlen(run));
+	vector_push_back(out, "\"");
+}
+
+static void json_write_value(vector* out, const json_value* value)
+{
+	switch (value->type) {
+		case JSON_TYPE_NULL:
+			vector_append(out, "null", 4);
+			break;
+		case JSON_TYPE_BOOL:
+			if (value->value.boolean) vector_append(out, "true", 4);
+			else vector_append(out, "false", 5);
+			break;
+		case JSON_TYPE_NUMBER: {
+			if (value->flags & JSON_FLAG_NUMBER_TEXT) {
+				vector_append(out, value->value.raw.text, value->value.raw.length);
+				break;
+			}
+			// 17 significant digits read back to the same double, numbers that overflowed
+			// while parsing are written so they overflow again
+			char buffer[32];
+			double number = value->value.number;
+			int len;
+			if (isinf(number)) len = snprintf(buffer, sizeof(buffer), "%s1e999", number < 0 ? "-" : "");
+			else len = snprintf(buffer, sizeof(buffer), "%.17g", number);
+			vector_append(out, buffer, len);
+			break;
+		}
+		case JSON_TYPE_STRING:
+			json_write_string(out, value->value.string);
+			break;
+		case JSON_TYPE_ARRAY:
+		case JSON_TYPE_OBJECT: {
+			int is_object = value->type == JSON_TYPE_OBJECT;
+			const json_value* items = (const json_value*)value->value.array.data;
+			vector_push_back(out, is_object ? "{" : "[");
+			for (size_t i = 0; i < value->value.array.size; ++i) {
+				if (i > 0) vector_push_back(out, (is_object && i % 2 == 1) ? ":" : ",");
+				json_write_value(out, &items[i]);
+			}
+			vector_push_back(out, is_object ? "}" : "]");
+			break;
+		}
+	}
+}
+
+char* json_serialize(const json_value* value)
+{
+	vector out;
+	vector_init(&out, sizeof(char));
+	json_write_value(&out, value);
+	vector_push_back(&out, "");
+	return out.data;
+}
+
+// Members of a and b from pair index from on are compared by key, duplicated keys are
+// paired up in the order they appear
+static int json_key_compare(const void* a, const void* b)
+{
+	const json_value* left = *(const json_value* const*)a;
+	const json_value* right = *(const json_value* const*)b;
+	int order = strcmp(left->value.key, right->value.key);
+	if (order != 0) return order;
+	return (left > right) - (left < right);
+}
+
+static int json_members_equal_unordered(const json_value* a, const json_value* b, size_t from)
+{
+	const json_value* left = (const json_value*)a->value.object.data + from * 2;
+	const json_value* right = (const json_value*)b->value.object.data + from * 2;
+	size_t count = a->value.object.size / 2 - from;
+
+	// Few members are looked up directly, more are sorted by key and compared pairwise
+	if (count <= 16) {
+		unsigned used = 0;
+		for (size_t i = 0; i < count; ++i) {
+			const char* key = left[i * 2].value.key;
+			size_t j = 0;
+			while (j < count && ((used >> j) & 1 || strcmp(right[j * 2].value.key, key) != 0)) ++j;
+			if (j == count || !json_equal(&left[i * 2 + 1], &right[j * 2 + 1])) return 0;
+			used |= 1u << j;
+		}
+		return 1;
+	}
+
+	const json_value** keys = malloc(count * 2 * sizeof(json_value*));
+	if (!keys) abort();
+	for (size_t i = 0; i < count; ++i) {
+		keys[i] = &left[i * 2];
+		keys[count + i] = &right[i * 2];
+	}
+	qsort(keys, count, sizeof(json_value*), json_key_compare);
+	qsort(keys + count, count, sizeof(json_value*), json_key_compare);
+	int equal = 1;
+	for (size_t i = 0; i < count && equal; ++i) {
+		equal = strcmp(keys[i]->value.key, keys[count + i]->value.key) == 0
+			&& json_equal(keys[i] + 1, keys[count + i] + 1);
+	}
+	free(keys);
+	return equal;
+}
+
+int json_equal(const json_value* a, const json_value* b)
+{
+	if (a == b) return 1;
+	if (a->type != b->type) return 0;
+
+	switch (a->type) {
+		case JSON_TYPE_NULL:
+			return 1;
+		case JSON_TYPE_BOOL:
+			return !a->value.boolean == !b->value.boolean;
+		case JSON_TYPE_NUMBER:
+			return json_number_value(a) == json_number_value(b);
+		case JSON_TYPE_STRING:
+			return strcmp(a->value.string, b->value.string) == 0;
+		case JSON_TYPE_ARRAY: {
+			if (a->value.array.size != b->value.array.size) return 0;
+			const json_value* left = (const json_value*)a->value.array.data;
+			const json_value* right = (const json_value*)b->value.array.data;
+			for (size_t i = 0; i < a->value.array.size; ++i) {
+				if (!json_equal(&left[i], &right[i])) return 0;
+			}
+			return 1;
+		}
+		case JSON_TYPE_OBJECT: {
+			if (a->value.object.size != b->value.object.size) return 0;
+			const json_value* left = (const json_value*)a->value.object.data;
+			const json_value* right = (const json_value*)b->value.object.data;
+			// Walk both in order while the keys line up, the common case for documents
+			// written by the same producer
+			size_t pairs = a->value.object.size / 2;
+			for (size_t i = 0; i < pairs; ++i) {
+				if (strcmp(left[i * 2].value.key, right[i * 2].value.key) != 0) {
+					return json_members_equal_unordered(a, b, i);
+				}
+				if (!json_equal(&left[i * 2 + 1], &right[i * 2 + 1])) return 0;
+			}
+			return 1;
+		}
+	}
+	return 0;
+}
+
+uint64_t json_hash_member(const char* key, const json_value* value)
+{
+	return json_hash_mix(json_key_hash(key, strlen(key)) ^ json_hash_mix(json_hash(value)));
+}
+
+uint64_t json_hash(const json_value* value)
+{
+	uint64_t type = (uint64_t)value->type << 56;
+	switch (value->type) {
+		case JSON_TYPE_BOOL:
+			return json_hash_mix(type | (value->value.boolean != 0));
+		case JSON_TYPE_NUMBER: {
+			// Equal numbers hash the same, 0.0 == -0.0
+			double number = json_number_value(value);
+			if (number == 0) number = 0;
+			uint64_t bits;
+			memcpy(&bits, &number, sizeof(bits));
+			return json_hash_mix(type ^ bits);
+		}
+		case JSON_TYPE_STRING:
+			return json_hash_mix(type ^ json_key_hash(value->value.string, strlen(value->value.string)));
+		case JSON_TYPE_ARRAY: {
+			uint64_t hash = json_hash_mix(type ^ value->value.array.size);
+			const json_value* items = (const json_value*)value->value.array.data;
+			for (size_t i = 0; i < value->value.array.size; ++i) {
+				hash = json_hash_mix(hash + json_hash(&items[i]));
+			}
+			return hash;
+		}
+		case JSON_TYPE_OBJECT: {
+			uint64_t hash = type;
+			const json_value* items = (const json_value*)value->value.object.data;
+			for (size_t i = 0; i < value->value.object.size; i += 2) {
+				hash += json_hash_member(items[i].value.key, &items[i + 1]);
+			}
+			return hash;
+		}
+	}
+	return json_hash_mix(type);
+}
+
+// Room for exactly count values, a single allocation unless a recycled container is used
+static void json_container_init_sized(json_parse_context* ctx, vector* v, size_t count)
+{
+	json_document* doc = ctx->doc;
+	if (doc && doc->next_container < doc->containers.size) {
+		json_container_init(ctx, v);
+		vector_reserve(v, count);
+		return;
+	}
+	v->data_size = sizeof(json_value);
+	v->capacity = count > 0 ? count : 1;
+	v->size = 0;
+	v->data = malloc(v->capacity * sizeof(json_value));
+	if (!v->data) abort();
+}
+
+static void json_clone_value(json_parse_context* ctx, json_value* dst, const json_value* src)
+{
+	*dst = *src;
+	dst->flags &= ~(unsigned)(JSON_FLAG_FROZEN | JSON_FLAG_KEY_INDEX);
+	switch (src->type) {
+		case JSON_TYPE_STRING: {
+			size_t size = strlen(src->value.string) + 1;
+			dst->value.string = json_string_alloc(ctx, size);
+			if (!dst->value.string) abort();
+			memcpy(dst->value.string, src->value.string, size);
+			break;
+		}
+		case JSON_TYPE_ARRAY:
+		case JSON_TYPE_OBJECT: {
+			size_t count = src->value.array.size;
+			size_t extra = (src->flags & JSON_FLAG_SORTED_KEYS) ? json_source_slots(count / 2) : 0;
+			json_container_init_sized(ctx, &dst->value.array, count + extra);
+			const json_value* items = (const json_value*)src->value.array.data;
+			json_value* copies = (json_value*)dst->value.array.data;
+			for (size_t i = 0; i < count; ++i) {
+				json_clone_value(ctx, &copies[i], &items[i]);
+			}
+			// The input positions of sorted objects come along
+			if (extra > 0) memcpy(copies + count, items + count, count / 2 * sizeof(uint32_t));
+			dst->value.array.size = count;
+			break;
+		}
+	}
+}
+
+void json_clone(json_value* dst, const json_value* src)
+{
+	json_parse_context ctx = { .depth = 0 };
+	json_clone_value(&ctx, dst, src);
+}
+
+void json_document_clone(json_document* doc, const json_value* src)
+{
+	json_document_clear(doc);
+	json_parse_context ctx = { .depth = 0, .doc = doc };
+	json_clone_value(&ctx, &doc->root, src);
+}
+
+static void json_key_index_build(json_value* object)
+{
+	json_value* data = (json_value*)object->value.object.data;
+	size_t members = object->value.object.size / 2;
+	size_t mask = json_key_index_slots(members) - 1;
+	json_key_slot* slots = json_key_index(object);
+	memset(slots, 0, (mask + 1) * sizeof(json_key_slot));
+	for (size_t member = 0; member < members; ++member) {
+		const char* key = data[member * 2].value.key;
+		uint64_t hash = json_key_hash(key, strlen(key));
+		uint32_t tag = (uint32_t)(hash >> 32);
+		size_t i = hash & mask;
+		int duplicate = 0;
+		for (; slots[i].member && !duplicate; i = (i + 1) & mask) {
+			duplicate = slots[i].tag == tag && strcmp(data[(slots[i].member - 1) * 2].value.key, key) == 0;
+		}
+		// Lookups find the first of duplicated keys, like the scan does
+		if (duplicate) continue;
+		slots[i].member = (uint32_t)member + 1;
+		slots[i].tag = tag;
+	}
+}
+
+// Convert lazy numbers, make room for the indexes behind the members and collect the
+// objects that get one. Objects are moved before their children are visited, so the
+// collected pointers stay valid
+static void json_freeze_prepare(json_value* value, unsigned flags, vector* objects)
+{
+	// Every value is marked, a pointer into the tree shows it is frozen as well
+	value->flags |= JSON_FLAG_FROZEN;
+	if (value->type == JSON_TYPE_NUMBER) {
+		json_number_materialize(value);
+		return;
+	}
+	if (value->type != JSON_TYPE_ARRAY && value->type != JSON_TYPE_OBJECT) return;
+
+	size_t size = value->value.object.size;
+	if (value->type == JSON_TYPE_OBJECT && (flags & JSON_FREEZE_INDEX) && !(value->flags & (JSON_FLAG_KEY_INDEX | JSON_FLAG_SORTED_KEYS))
+		&& size / 2 >= JSON_INDEX_MIN_MEMBERS && size / 2 < UINT32_MAX) {
+		size_t bytes = size * sizeof(json_value) + json_key_index_slots(size / 2) * sizeof(json_key_slot);
+		char* data = realloc(value->value.object.data, bytes);
+		if (!data) abort();
+		value->value.object.data = data;
+		value->value.object.capacity = size;
+		value->flags |= JSON_FLAG_KEY_INDEX;
+		vector_push_back(objects, &value);
+	}
+
+	json_value* items = (json_value*)value->value.array.data;
+	for (size_t i = 0; i < size; ++i) {
+		json_freeze_prepare(&items[i], flags, objects);
+	}
+}
+
+// Share of the objects to index, every step-th one starting at first
+typedef struct {
+	json_value** objects;
+	size_t count;
+	size_t first;
+	size_t step;
+} json_freeze_share;
+
+static void* json_freeze_worker(void* argument)
+{
+	json_freeze_share* share = argument;
+	for (size_t i = share->first; i < share->count; i += share->step) {
+		json_key_index_build(share->objects[i]);
+	}
+	return NULL;
+}
+
+void json_freeze(json_value* root, unsigned flags, unsigned threads)
+{
+	vector objects;
+	vector_init(&objects, sizeof(json_value*));
+	json_freeze_prepare(root, flags, &objects);
+
+	json_freeze_share all = { (json_value**)objects.data, objects.size, 0, 1 };
+#ifdef JSON_THREADS
+	// Every table lives in its own object's allocation, the workers share nothing
+	if (threads > objects.size) threads = (unsigned)objects.size;
+	if (threads > 1) {
+		pthread_t* ids = malloc(threads * sizeof(pthread_t));
+		json_freeze_share* shares = malloc(threads * sizeof(json_freeze_share));
+		if (!ids || !shares) abort();
+		for (unsigned t = 0; t < threads; ++t) {
+			shares[t] = all;
+			shares[t].first = t;
+			shares[t].step = threads;
+		}
+		// Share 0 and those of threads that couldn't be started are done here
+		unsigned started = 1;
+		while (started < threads && pthread_create(&ids[started], NULL, json_freeze_worker, &shares[started]) == 0) ++started;
+		json_freeze_worker(&shares[0]);
+		for (unsigned t = started; t < threads; ++t) json_freeze_worker(&shares[t]);
+		for (unsigned t = 1; t < started; ++t) pthread_join(ids[t], NULL);
+		free(ids);
+		free(shares);
+		all.count = 0;
+	}
+#else
+	(void)threads;
+#endif
+	json_freeze_worker(&all);
+
+	vector_free(&objects);
+}
+
+void json_thaw(json_value* root)
+{
+	root->flags &= ~(unsigned)(JSON_FLAG_FROZEN | JSON_FLAG_KEY_INDEX);
+	if (root->type != JSON_TYPE_ARRAY && root->type != JSON_TYPE_OBJECT) return;
+	json_value* items = (json_value*)root->value.array.data;
+	for (size_t i = 0; i < root->value.array.size; ++i) {
+		json_thaw(&items[i]);
+	}
+}
+
 #ifdef BUILD_TEST
 
 #include <stdio.h>
 
+static int test_parse_value(const char** cursor, json_value* result)
+{
+	json_parse_context ctx = { .depth = 0 };
+	return json_parse_value(&ctx, cursor, result);
+}
+
 void json_test_value_string(void)
 {
 	printf("json_parse_value_string: ");
 	// Normal parse, skip whitespace
 	const char* string = "     \n\t\"Hello \\\"World!\"";
 	json_value result = { .type = JSON_TYPE_NULL };
-	assert(json_parse_value(&string, &result));
+	assert(test_parse_value(&string, &result));
 	assert(result.type == JSON_TYPE_STRING);
 	assert(result.value.string != NULL);
 	//assert(strlen(result.value.string) == 12);
@@ -333,7 +1650,7 @@ void json_test_value_string(void)
 
 	// Empty string
 	string = "\"\"";
-	json_parse_value(&string, &result);
+	test_parse_value(&string, &result);
 	assert(result.type == JSON_TYPE_STRING);
 	assert(result.value.string != NULL);
 	assert(strlen(result.value.string) == 0);
@@ -347,7 +1664,7 @@ void json_test_value_number(void)
 	printf("json_test_value_number: ");
 	const char* string = "  23.4";
 	json_value result = { .type = JSON_TYPE_NULL };
-	assert(json_parse_value(&string, &result));
+	assert(test_parse_value(&string, &result));
 	assert(result.type == JSON_TYPE_NUMBER);
 	assert(result.value.number == 23.4);
 
@@ -362,7 +1679,7 @@ void json_test_value_invalid(void)
 		// not a valid value
 		const char* string = "xxx";
 		json_value result = { .type = JSON_TYPE_NULL };
-		assert(!json_parse_value(&string, &result));
+		assert(!test_parse_value(&string, &result));
 		assert(result.type == JSON_TYPE_NULL);
 		json_free_value(&result);
 	}
@@ -370,7 +1687,7 @@ void json_test_value_invalid(void)
 		// parse_value at end should fail
 		const char* string = "";
 		json_value result = { .type = JSON_TYPE_NULL };
-		assert(!json_parse_value(&string, &result));
+		assert(!test_parse_value(&string, &result));
 		assert(result.type == JSON_TYPE_NULL);
 		json_free_value(&result);
 	}
@@ -385,7 +1702,7 @@ void json_test_value_array(void)
 		const char* string = "[]";
 		json_value result = { .type = JSON_TYPE_NULL };
 		assert(result.value.array.data == NULL);
-		assert(json_parse_value(&string, &result));
+		assert(test_parse_value(&string, &result));
 		assert(result.type = JSON_TYPE_ARRAY);
 		assert(result.value.array.data != NULL);
 		assert(result.value.array.size == 0);
@@ -397,7 +1714,7 @@ void json_test_value_array(void)
 		const char* string = "[\"Hello World\"]";
 		json_value result = { .type = JSON_TYPE_NULL };
 		assert(result.value.array.data == NULL);
-		assert(json_parse_value(&string, &result));
+		assert(test_parse_value(&string, &result));
 		assert(result.type = JSON_TYPE_ARRAY);
 		assert(result.value.array.data != NULL);
 		assert(result.value.array.size == 1);
@@ -414,7 +1731,7 @@ void json_test_value_array(void)
 		const char* string = "[0, 1, 2, 3]";
 		json_value result = { .type = JSON_TYPE_NULL };
 		assert(result.value.array.data == NULL);
-		assert(json_parse_value(&string, &result));
+		assert(test_parse_value(&string, &result));
 		assert(result.type = JSON_TYPE_ARRAY);
 		assert(result.value.array.data != NULL);
 		assert(result.value.array.size == 4);
@@ -427,7 +1744,7 @@ void json_test_value_array(void)
 		const char* string = "[0, 2,,]";
 		json_value result = { .type = JSON_TYPE_NULL };
 		assert(result.value.array.data == NULL);
-		assert(!json_parse_value(&string, &result));
+		assert(!test_parse_value(&string, &result));
 		assert(result.type == JSON_TYPE_NULL);
 		assert(result.value.array.data == NULL);
 
@@ -439,7 +1756,7 @@ void json_test_value_array(void)
 		const char* string = "[0, 2, 0";
 		json_value result = { .type = JSON_TYPE_NULL };
 		assert(result.value.array.data == NULL);
-		assert(!json_parse_value(&string, &result));
+		assert(!test_parse_value(&string, &result));
 		assert(result.type == JSON_TYPE_NULL);
 		assert(result.value.array.data == NULL);
 	}
@@ -456,7 +1773,7 @@ void json_test_value_object(void)
 		const char* string = "{}";
 		json_value result = { .type = JSON_TYPE_NULL };
 		assert(result.value.object.data == NULL);
-		assert(json_parse_value(&string, &result));
+		assert(test_parse_value(&string, &result));
 		assert(result.type = JSON_TYPE_OBJECT);
 		assert(result.value.array.data != NULL);
 		assert(result.value.array.size == 0);
@@ -468,7 +1785,7 @@ void json_test_value_object(void)
 		const char* string = "{ \"a\"  :   1  }";
 		json_value result = { .type = JSON_TYPE_NULL };
 		assert(result.value.object.data == NULL);
-		assert(json_parse_value(&string, &result));
+		assert(test_parse_value(&string, &result));
 		assert(result.type = JSON_TYPE_OBJECT);
 		assert(result.value.array.data != NULL);
 		assert(result.value.array.size == 2);
@@ -486,7 +1803,7 @@ void json_test_value_object(void)
 		const char* string = "{ \"a\": 1, \"b\" : 2, \"c\" : 3 }";
 		json_value result = { .type = JSON_TYPE_NULL };
 		assert(result.value.object.data == NULL);
-		assert(json_parse_value(&string, &result));
+		assert(test_parse_value(&string, &result));
 		assert(result.type = JSON_TYPE_OBJECT);
 		assert(result.value.array.data != NULL);
 		assert(result.value.array.size == 6);
@@ -506,7 +1823,7 @@ void json_test_value_literal(void) {
 	{
 		const char* string = "true";
 		json_value result = { .type = JSON_TYPE_NULL };
-		assert(json_parse_value(&string, &result));
+		assert(test_parse_value(&string, &result));
 		assert(result.type == JSON_TYPE_BOOL);
 		assert(result.value.boolean);
 		json_free_value(&result);
@@ -515,7 +1832,7 @@ void json_test_value_literal(void) {
 	{
 		const char* string = "false";
 		json_value result = { .type = JSON_TYPE_NULL };
-		assert(json_parse_value(&string, &result));
+		assert(test_parse_value(&string, &result));
 		assert(result.type == JSON_TYPE_BOOL);
 		assert(!result.value.boolean);
 		json_free_value(&result);
@@ -524,7 +1841,7 @@ void json_test_value_literal(void) {
 	{
 		const char* string = "null";
 		json_value result = { .type = JSON_TYPE_NULL };
-		assert(json_parse_value(&string, &result));
+		assert(test_parse_value(&string, &result));
 		assert(result.type == JSON_TYPE_NULL);
 		json_free_value(&result);
 	}
@@ -582,6 +1899,698 @@ void json_test_coarse(void)
 	printf(" OK\n");
 }
 
+void json_test_strict(void)
+{
+	printf("json_test_strict: ");
+	const char* invalid[] = {
+		"01", "1.", ".5", "+1", "0x10", "nan", "-Infinity", "1e", "[1,]", "{\"a\":1,}",
+		"{\"a\"}", "{1:2}", "\"\\x\"", "\"a\\u0000b\"", "\"\\ud800\"", "\"\\udc00\"", "\"a\tb\"", "\"\\u12\"", "\f1"
+	};
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+		json_value root = { .type = JSON_TYPE_NULL };
+		assert(!json_parse(invalid[i], &root));
+		assert(root.type == JSON_TYPE_NULL);
+	}
+
+	json_value root;
+	assert(json_parse("\"\\\\\\\\\"", &root));
+	assert(strcmp(json_value_to_string(&root), "\\\\") == 0);
+	json_free_value(&root);
+	assert(json_parse("\"\\b\\f\\n\\r\\t\\/\\u0041\\u00e9\\ud83d\\ude00\"", &root));
+	assert(strcmp(json_value_to_string(&root), "\b\f\n\r\t/A\xC3\xA9\xF0\x9F\x98\x80") == 0);
+	json_free_value(&root);
+	assert(json_parse("-0.5e+2", &root));
+	assert(json_value_to_double(&root) == -50.0);
+
+	// Nesting is limited
+	char deep[2 * JSON_MAX_DEPTH + 3];
+	memset(deep, '[', JSON_MAX_DEPTH + 1);
+	memset(deep + JSON_MAX_DEPTH + 1, ']', JSON_MAX_DEPTH + 1);
+	deep[2 * JSON_MAX_DEPTH + 2] = '\0';
+	assert(!json_parse(deep, &root));
+	deep[2 * JSON_MAX_DEPTH + 1] = '\0';
+	assert(json_parse(deep + 1, &root));
+	json_free_value(&root);
+	printf(" OK\n");
+}
+
+void json_test_strict_utf8(void)
+{
+	printf("json_test_strict_utf8: ");
+	json_parse_options strict = { .flags = JSON_PARSE_STRICT_UTF8 };
+
+	// Long strings go through the 16 byte blocks, short ones through the scalar loop
+	const char* valid[] = {
+		"\"\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\xF4\x8F\xBF\xBF\"",
+		"\"0123456789abcdef0123456789abcdef\xC3\xA9 tail\"",
+		"{\"k\xC3\xA9y\" : \"0123456789abcdef\\n0123456789abcdef\xEF\xBF\xBD\"}",
+	};
+	for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); ++i) {
+		json_value root;
+		assert(json_parse_ex(valid[i], &root, &strict));
+		json_free_value(&root);
+	}
+
+	const char* invalid[] = {
+		"\"\xFF\"", // Never valid
+		"\"\xC0\xAF\"", // Overlong '/'
+		"\"\xE0\x80\xAF\"", // Overlong '/'
+		"\"\xED\xA0\x80\"", // Encoded surrogate
+		"\"\xF4\x90\x80\x80\"", // Above U+10FFFF
+		"\"\x80\"", // Stray continuation byte
+		"\"\xE2\x82\"", // Truncated
+		"\"0123456789abcdef0123456789abcdef\xC3\"",
+		"{\"0123456789abcdef\xF0\x9F\x98\" : 1}",
+	};
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+		json_value root = { .type = JSON_TYPE_NULL };
+		assert(!json_parse_ex(invalid[i], &root, &strict));
+		assert(root.type == JSON_TYPE_NULL);
+		// Bytes are passed through unchecked by default
+		assert(json_parse(invalid[i], &root));
+		json_free_value(&root);
+	}
+
+	// The block scan starts and ends anywhere within a block, including right at the end
+	// of the allocation
+	for (size_t offset = 0; offset < 16; ++offset) {
+		for (size_t length = 0; length < 40; ++length) {
+			char* text = malloc(offset + length + 3);
+			memset(text + offset + 1, 'x', length);
+			text[offset] = '"';
+			text[offset + length + 1] = '"';
+			text[offset + length + 2] = '\0';
+			json_value root;
+			assert(json_parse_ex(text + offset, &root, &strict));
+			assert(strlen(json_value_to_string(&root)) == length);
+			json_free_value(&root);
+			text[offset + length + 1] = '\0';
+			assert(!json_parse(text + offset, &root));
+			free(text);
+		}
+	}
+	printf(" OK\n");
+}
+
+void json_test_projection(void)
+{
+	printf("json_test_projection: ");
+	json_projection projection;
+	json_projection_init(&projection);
+	assert(json_projection_add(&projection, "/id"));
+	assert(json_projection_add(&projection, "/user/name"));
+	assert(json_projection_add(&projection, "/a~1b"));
+	assert(json_projection_add(&projection, "/tags/x"));
+	assert(json_projection_add(&projection, "/tags"));
+	assert(!json_projection_add(&projection, "id"));
+	assert(!json_projection_add(&projection, "/a~2"));
+
+	json_parse_options options = { .projection = &projection };
+	const char* records = "[ { \"id\" : 1, \"payload\" : { \"big\" : [1, 2, {\"x\" : \"\\u0041\"}] }, "
+		"\"user\" : { \"name\" : \"n\", \"email\" : \"e\" }, \"a/b\" : true, \"tags\" : { \"x\" : 1, \"y\" : 2 } }, "
+		"{ \"\\u0069d\" : 2, \"user\" : 7 } ]";
+	json_value root;
+	assert(json_parse_ex(records, &root, &options));
+	char* text = json_serialize(&root);
+	assert(strcmp(text, "[{\"id\":1,\"user\":{\"name\":\"n\"},\"a/b\":true,\"tags\":{\"x\":1,\"y\":2}},{\"id\":2,\"user\":7}]") == 0);
+	free(text);
+	json_free_value(&root);
+
+	// Skipped values are still checked
+	const char* invalid[] = {
+		"{\"skip\" : [1, 2,]}", "{\"skip\" : {\"a\" 1}}", "{\"skip\" : \"\\x\"}", "{\"skip\" : 01}", "{\"skip\" : tru}"
+	};
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+		json_value result = { .type = JSON_TYPE_NULL };
+		assert(!json_parse_ex(invalid[i], &result, &options));
+		assert(result.type == JSON_TYPE_NULL);
+	}
+
+	// The empty path selects everything
+	json_projection all;
+	json_projection_init(&all);
+	assert(json_projection_add(&all, "/id"));
+	assert(json_projection_add(&all, ""));
+	options.projection = &all;
+	assert(json_parse_ex("{\"x\" : 1}", &root, &options));
+	assert(root.value.object.size == 2);
+	json_free_value(&root);
+
+	json_projection_free(&all);
+	json_projection_free(&projection);
+	printf(" OK\n");
+}
+
+void json_test_lazy_numbers(void)
+{
+	printf("json_test_lazy_numbers: ");
+	json_parse_options options = { .flags = JSON_PARSE_LAZY_NUMBERS };
+	const char* input = "{ \"id\" : 9007199254740993, \"big\" : 123456789012345678901234567890, \"price\" : 1.50, \"neg\" : -4e0 }";
+	json_value root;
+	assert(json_parse_ex(input, &root, &options));
+
+	// Serialized byte for byte
+	char* text = json_serialize(&root);
+	assert(strcmp(text, "{\"id\":9007199254740993,\"big\":123456789012345678901234567890,\"price\":1.50,\"neg\":-4e0}") == 0);
+	free(text);
+
+	json_value* id = json_value_with_key(&root, "id");
+	assert(id->flags & JSON_FLAG_NUMBER_PENDING);
+	int64_t integer = 0;
+	assert(json_get_int64(id, &integer) && integer == 9007199254740993LL);
+
+	const char* digits;
+	size_t length;
+	json_value* big = json_value_with_key(&root, "big");
+	assert(!json_get_int64(big, &integer));
+	assert(json_get_number_text(big, &digits, &length) && length == 30);
+	assert(strncmp(digits, "123456789012345678901234567890", length) == 0);
+
+	json_value* price = json_value_with_key(&root, "price");
+	assert(json_number_value(price) == 1.5);
+	assert(price->flags & JSON_FLAG_NUMBER_PENDING);
+	double d = 0;
+	assert(json_get_double(price, &d) && d == 1.5);
+	assert(!(price->flags & JSON_FLAG_NUMBER_PENDING));
+	assert(price->value.number == 1.5);
+	assert(!json_get_int64(price, &integer));
+
+	json_value* neg = json_value_with_key(&root, "neg");
+	assert(json_get_int64(neg, &integer) && integer == -4);
+	assert(json_value_to_double(neg) == -4.0);
+	json_free_value(&root);
+	assert(root.flags == 0);
+
+	// Both modes agree on which numbers are integers, only the digits of large plain
+	// integers are kept exactly
+	const char* numbers[] = {
+		"1.0", "1e2", "-4E0", "2.5e1", "0.5", "1e-1", "-9223372036854775808",
+		"9223372036854775808", "1e19", "-0", "123456789012345678901234567890"
+	};
+	for (size_t i = 0; i < sizeof(numbers) / sizeof(numbers[0]); ++i) {
+		json_value eager, lazy;
+		int64_t eager_integer = 0, lazy_integer = 0;
+		assert(json_parse(numbers[i], &eager));
+		assert(json_parse_ex(numbers[i], &lazy, &options));
+		int eager_ok = json_get_int64(&eager, &eager_integer);
+		assert(json_get_int64(&lazy, &lazy_integer) == eager_ok);
+		assert(eager_integer == lazy_integer);
+		json_free_value(&eager);
+		json_free_value(&lazy);
+	}
+
+	// Eagerly parsed numbers have no text
+	assert(json_parse("1.50", &root));
+	assert(!json_get_number_text(&root, &digits, &length));
+
+	// The flags of whatever was in root before are not kept
+	const char* roots[] = { "[1, 2]", "\"s\"", "true", "null", "{\"k\" : [{}]}", "3" };
+	for (size_t i = 0; i < sizeof(roots) / sizeof(roots[0]); ++i) {
+		json_value copy;
+		memset(&root, 0xFF, sizeof(root));
+		assert(json_parse(roots[i], &root));
+		assert(root.flags == 0);
+		json_clone(&copy, &root);
+		assert(json_equal(&copy, &root));
+		json_free_value(&copy);
+		json_free_value(&root);
+	}
+	printf(" OK\n");
+}
+
+void json_test_serialize(void)
+{
+	printf("json_test_serialize: ");
+	json_value root;
+	assert(json_parse(" { \"a\" : [1, 2.5, -3e-7, true, false, null], \"b\\n\" : { \"q\\\"\" : \"\\u0001\\\\\" }, \"c\" : [] } ", &root));
+	char* text = json_serialize(&root);
+	assert(strcmp(text, "{\"a\":[1,2.5,-2.9999999999999999e-07,true,false,null],\"b\\n\":{\"q\\\"\":\"\\u0001\\\\\"},\"c\":[]}") == 0);
+
+	json_value again;
+	assert(json_parse(text, &again));
+	char* text_again = json_serialize(&again);
+	assert(strcmp(text, text_again) == 0);
+
+	free(text);
+	free(text_again);
+	json_free_value(&root);
+	json_free_value(&again);
+	printf(" OK\n");
+}
+
+void json_test_accessors(void)
+{
+	printf("json_test_accessors: ");
+
+	json_value root;
+	assert(json_parse("{ \"a\" : { \"b\" : 2.5, \"i\" : -42, \"big\" : 1e19, \"s\" : \"x\", \"t\" : true }, \"l\" : [10, 20] }", &root));
+
+	double d = 0;
+	int64_t i = 0;
+	int b = 0;
+	const char* str = NULL;
+	assert(json_get_path_double(&root, &d, "a", "b") && d == 2.5);
+	assert(json_get_path_int64(&root, &i, "a", "i") && i == -42);
+	assert(json_get_path_string(&root, &str, "a", "s") && strcmp(str, "x") == 0);
+	assert(json_get_path_bool(&root, &b, "a", "t") && b == 1);
+
+	// Wrong types, fractions and out of range leave out untouched
+	i = 7;
+	assert(!json_get_path_int64(&root, &i, "a", "b"));
+	assert(!json_get_path_int64(&root, &i, "a", "big"));
+	assert(!json_get_path_int64(&root, &i, "a", "s"));
+	assert(i == 7);
+	assert(!json_get_path_double(&root, &d, "a", "missing"));
+	assert(!json_get_path_double(&root, &d, "l", "b"));
+	assert(!json_get_double(NULL, &d));
+	assert(d == 2.5);
+
+	// Indexing
+	const json_value* list = json_get_path(&root, "l");
+	assert(json_get_int64(json_get_at(list, 1), &i) && i == 20);
+	assert(json_get_at(list, 2) == NULL);
+	assert(json_get_at(json_get_path(&root, "a"), 0) == NULL);
+	assert(json_value_at(list, 0) != NULL);
+	assert(json_value_to_double(json_value_at(list, 0)) == 10.0);
+	assert(json_value_at(list, 2) == NULL);
+
+	// Keys with a length, "bx" must not match "b"
+	const json_value* a = json_get_path(&root, "a");
+	assert(json_value_with_key_hashed(a, "bx", 1, json_key_hash("b", 1)) == json_value_with_key(a, "b"));
+	assert(json_value_with_key_hashed(a, "bx", 2, json_key_hash("bx", 2)) == NULL);
+	assert(json_value_with_key_hashed(list, "b", 1, json_key_hash("b", 1)) == NULL);
+	assert(json_key_hash("", 0) == 14695981039346656037ull);
+
+	json_free_value(&root);
+	printf(" OK\n");
+}
+
+void json_test_document(void)
+{
+	printf("json_test_document: ");
+
+	json_document doc;
+	json_document_init(&doc);
+	assert(json_document_parse(&doc, test_string_valid));
+	assert(doc.root.type == JSON_TYPE_OBJECT);
+	void* members = doc.root.value.object.data;
+	char* key = json_value_to_string(vector_get(&doc.root.value.object, 0));
+	json_value* item3 = json_value_with_key(&doc.root, "item3");
+	assert(strcmp(json_value_to_string(item3), "An Item") == 0);
+
+	// Same shape, the memory of the first parse is handed out again
+	assert(json_document_parse(&doc, "{ \"x\" : [5, 6], \"y\" : { \"a\" : 1 }, \"z\" : \"Other\" }"));
+	assert(doc.root.value.object.data == members);
+	assert(json_value_to_string(vector_get(&doc.root.value.object, 0)) == key);
+	assert(strcmp(key, "x") == 0);
+	assert(json_value_to_double(json_value_at(json_value_with_key(&doc.root, "x"), 1)) == 6.0);
+	assert(strcmp(json_value_to_string(json_value_with_key(&doc.root, "z")), "Other") == 0);
+
+	// Clear keeps the memory, a failed parse leaves an empty root
+	json_document_clear(&doc);
+	assert(doc.root.type == JSON_TYPE_NULL);
+	assert(doc.containers.size == 3);
+	assert(doc.strings.size == 7);
+	assert(!json_document_parse(&doc, test_string_invalid));
+	assert(doc.root.type == JSON_TYPE_NULL);
+	assert(json_document_parse(&doc, "[\"a string that is longer than any before\", {}]"));
+	assert(strcmp(json_value_to_string(json_value_at(&doc.root, 0)), "a string that is longer than any before") == 0);
+
+#ifdef JSON_STATS
+	// Once warm there are no allocations at all
+	assert(json_document_parse(&doc, test_string_valid));
+	json_stats_reset_global();
+	assert(json_document_parse(&doc, test_string_valid));
+	json_parse_stats total;
+	json_stats_global(&total);
+	assert(total.allocations == 0);
+	assert(total.reallocations == 0);
+
+	// A buffer keeps its size while it holds shorter strings
+	const char* long_strings = "[\"a string that is quite a bit longer than the rest\", \"another long string in here\"]";
+	assert(json_document_parse(&doc, long_strings));
+	assert(json_document_parse(&doc, "[\"a\", \"b\"]"));
+	json_stats_reset_global();
+	assert(json_document_parse(&doc, long_strings));
+	json_stats_global(&total);
+	assert(total.allocations == 0);
+	assert(total.reallocations == 0);
+#endif
+
+	json_document_free(&doc);
+	printf(" OK\n");
+}
+
+#ifdef JSON_STATS
+#ifdef JSON_THREADS
+static void* json_test_parse_counted(void* argument)
+{
+	(void)argument;
+	for (int i = 0; i < 100; ++i) {
+		json_value root;
+		assert(json_parse(i % 2 ? "[[1]]" : "{\"a\":[[[2]]]}", &root));
+		json_free_value(&root);
+	}
+	return NULL;
+}
+#endif
+
+void json_test_stats(void)
+{
+	printf("json_test_stats: ");
+
+	json_stats_reset_global();
+	json_parse_stats stats;
+	json_value root;
+	assert(json_parse_with_stats(test_string_valid, &root, &stats));
+	assert(stats.bytes == strlen(test_string_valid));
+	assert(stats.values[JSON_TYPE_OBJECT] == 2);
+	assert(stats.values[JSON_TYPE_ARRAY] == 1);
+	assert(stats.values[JSON_TYPE_NUMBER] == 7);
+	assert(stats.values[JSON_TYPE_STRING] == 7);
+	assert(stats.max_depth == 2);
+	assert(stats.string_bytes == 25);
+	assert(stats.allocations == 10);
+	assert(stats.reallocations == 8);
+	json_free_value(&root);
+
+	assert(json_parse("[[[]]]", &root));
+	json_free_value(&root);
+
+	json_parse_stats total;
+	json_stats_global(&total);
+	assert(total.values[JSON_TYPE_ARRAY] == 4);
+	assert(total.max_depth == 3);
+	assert(total.allocations == 13);
+	assert(total.parse_seconds >= 0);
+
+#ifdef JSON_THREADS
+	// Concurrent parses lose no counts
+	json_stats_reset_global();
+	pthread_t threads[4];
+	for (int t = 0; t < 4; ++t) assert(pthread_create(&threads[t], NULL, json_test_parse_counted, NULL) == 0);
+	for (int t = 0; t < 4; ++t) pthread_join(threads[t], NULL);
+	json_stats_global(&total);
+	assert(total.values[JSON_TYPE_ARRAY] == 4 * (50 * 2 + 50 * 3));
+	assert(total.values[JSON_TYPE_NUMBER] == 4 * 100);
+	assert(total.max_depth == 4);
+#endif
+
+	printf(" OK\n");
+}
+#endif
+
+void json_test_equal_hash_clone(void)
+{
+	printf("json_test_equal_hash_clone: ");
+
+	json_value a, b, c;
+	assert(json_parse("{ \"x\" : [1, 2.0, -0], \"y\" : { \"s\" : \"t\", \"n\" : null }, \"z\" : true }", &a));
+	assert(json_parse("{\"z\":true,\"y\":{\"n\":null,\"s\":\"t\"},\"x\":[1.0,2,0]}", &b));
+	assert(json_equal(&a, &b) && json_equal(&b, &a));
+	assert(json_hash(&a) == json_hash(&b));
+
+	// Array order, types and values all count
+	const char* different[] = {
+		"{\"z\":true,\"y\":{\"n\":null,\"s\":\"t\"},\"x\":[2,1,0]}",
+		"{\"z\":1,\"y\":{\"n\":null,\"s\":\"t\"},\"x\":[1,2,0]}",
+		"{\"z\":true,\"y\":{\"n\":null,\"s\":\"u\"},\"x\":[1,2,0]}",
+		"{\"z\":true,\"y\":{\"n\":null,\"S\":\"t\"},\"x\":[1,2,0]}",
+		"{\"z\":true,\"y\":{\"n\":null},\"x\":[1,2,0]}",
+		"{\"z\":true,\"y\":{\"n\":null,\"s\":\"t\"},\"x\":[1,2,0],\"w\":0}",
+	};
+	for (size_t i = 0; i < sizeof(different) / sizeof(different[0]); ++i) {
+		assert(json_parse(different[i], &c));
+		assert(!json_equal(&a, &c) && !json_equal(&c, &a));
+		assert(json_hash(&a) != json_hash(&c));
+		json_free_value(&c);
+	}
+
+	// Lazy numbers compare by value
+	json_parse_options lazy = { .flags = JSON_PARSE_LAZY_NUMBERS };
+	assert(json_parse_ex("{\"x\":[1.00,2e0,0],\"y\":{\"s\":\"t\",\"n\":null},\"z\":true}", &c, &lazy));
+	assert(json_equal(&a, &c) && json_hash(&a) == json_hash(&c));
+	json_free_value(&c);
+
+	// Member hashes add up, replacing one updates the object's hash
+	json_value* x = json_value_with_key(&a, "x");
+	uint64_t hash = json_hash(&a) - json_hash_member("x", x);
+	json_value replacement = { .type = JSON_TYPE_BOOL, .value.boolean = 0 };
+	json_free_value(x);
+	*x = replacement;
+	assert(json_hash(&a) == hash + json_hash_member("x", &replacement));
+
+	// Objects too big for the direct lookup go through the sorted comparison
+	vector forward, backward;
+	vector_init(&forward, sizeof(char));
+	vector_init(&backward, sizeof(char));
+	for (int i = 0; i < 40; ++i) {
+		char member[32];
+		sprintf(member, "%s\"k%d\":%d", i ? "," : "{", i, i);
+		vector_append(&forward, member, strlen(member));
+		sprintf(member, "%s\"k%d\":%d", i ? "," : "{", 39 - i, 39 - i);
+		vector_append(&backward, member, strlen(member));
+	}
+	vector_append(&forward, "}", 2);
+	vector_append(&backward, "}", 2);
+	json_free_value(&b);
+	assert(json_parse(forward.data, &b));
+	assert(json_parse(backward.data, &c));
+	assert(json_equal(&b, &c) && json_hash(&b) == json_hash(&c));
+	json_value_with_key(&c, "k7")->value.number = 8;
+	assert(!json_equal(&b, &c));
+	json_free_value(&c);
+	vector_free(&forward);
+	vector_free(&backward);
+
+	// Clones are exact size and independent of the original
+	json_clone(&c, &b);
+	assert(json_equal(&b, &c));
+	assert(c.value.object.capacity == 80);
+	assert(c.value.object.data != b.value.object.data);
+	assert(json_value_to_string(vector_get(&c.value.object, 0)) != json_value_to_string(vector_get(&b.value.object, 0)));
+	json_free_value(&b);
+	char* text = json_serialize(&c);
+	assert(strncmp(text, "{\"k0\":0,\"k1\":1,", 15) == 0);
+	free(text);
+
+	// Cloning into a warm document reuses its memory
+	json_document doc;
+	json_document_init(&doc);
+	json_document_clone(&doc, &c);
+	void* members = doc.root.value.object.data;
+	json_document_clone(&doc, &a);
+	json_document_clone(&doc, &c);
+	assert(doc.root.value.object.data == members);
+	assert(json_equal(&doc.root, &c));
+	json_document_free(&doc);
+
+	json_free_value(&a);
+	json_free_value(&c);
+	printf(" OK\n");
+}
+
+#ifdef JSON_THREADS
+typedef struct {
+	const json_value* root;
+	int found;
+} json_test_reader;
+
+static void* json_test_read_frozen(void* argument)
+{
+	json_test_reader* reader = argument;
+	char key[8];
+	for (int round = 0; round < 1000; ++round) {
+		sprintf(key, "k%d", round % 40);
+		const json_value* value = json_value_with_key(reader->root, key);
+		double d;
+		if (value && json_get_double(value, &d) && d == round % 40) ++reader->found;
+	}
+	return NULL;
+}
+#endif
+
+// 1 if flag is set, or with set 0 clear, on value and everything below it
+static int json_test_all_flagged(const json_value* value, unsigned flag, int set)
+{
+	if (!(value->flags & flag) != !set) return 0;
+	if (value->type != JSON_TYPE_ARRAY && value->type != JSON_TYPE_OBJECT) return 1;
+	const json_value* items = (const json_value*)value->value.array.data;
+	for (size_t i = 0; i < value->value.array.size; ++i) {
+		if (!json_test_all_flagged(&items[i], flag, set)) return 0;
+	}
+	return 1;
+}
+
+void json_test_freeze(void)
+{
+	printf("json_test_freeze: ");
+
+	vector text;
+	vector_init(&text, sizeof(char));
+	vector_append(&text, "{\"dup\":\"first\",\"small\":{\"a\":1},", 31);
+	for (int i = 0; i < 40; ++i) {
+		char member[32];
+		sprintf(member, "\"k%d\":%d,", i, i);
+		vector_append(&text, member, strlen(member));
+	}
+	vector_append(&text, "\"dup\":\"second\",\"\":[{\"x\":1e2}]}", 31);
+
+	json_parse_options lazy = { .flags = JSON_PARSE_LAZY_NUMBERS };
+	json_value root, plain;
+	assert(json_parse_ex(text.data, &root, &lazy));
+	json_clone(&plain, &root);
+	json_freeze(&root, JSON_FREEZE_INDEX, 4);
+
+	assert(root.flags == (JSON_FLAG_FROZEN | JSON_FLAG_KEY_INDEX));
+	assert(json_value_with_key(&root, "small")->flags == JSON_FLAG_FROZEN);
+	assert(json_test_all_flagged(&root, JSON_FLAG_FROZEN, 1));
+	assert(json_equal(&root, &plain));
+
+	// Every lookup agrees with the scan, numbers are converted already
+	for (size_t i = 0; i < plain.value.object.size; i += 2) {
+		const char* key = json_value_to_string(vector_get(&plain.value.object, i));
+		json_value* found = json_value_with_key(&root, key);
+		size_t position = json_value_with_key(&plain, key) - (json_value*)plain.value.object.data;
+		assert(found == (json_value*)root.value.object.data + position);
+		assert(!(found->flags & JSON_FLAG_NUMBER_PENDING));
+	}
+	assert(strcmp(json_value_to_string(json_value_with_key(&root, "dup")), "first") == 0);
+	assert(json_value_with_key(&root, "k40") == NULL);
+	assert(json_value_with_key(&root, "k") == NULL);
+	assert(json_value_with_key_hashed(&root, "k39x", 3, json_key_hash("k39", 3)) == json_value_with_key(&root, "k39"));
+	assert(json_get_path(&root, "", "x") == NULL);
+	assert(json_value_with_key(json_get_at(json_get_path(&root, ""), 0), "x")->value.number == 100);
+
+#ifdef JSON_THREADS
+	pthread_t threads[4];
+	json_test_reader readers[4];
+	for (int t = 0; t < 4; ++t) {
+		readers[t].root = &root;
+		readers[t].found = 0;
+		assert(pthread_create(&threads[t], NULL, json_test_read_frozen, &readers[t]) == 0);
+	}
+	for (int t = 0; t < 4; ++t) {
+		pthread_join(threads[t], NULL);
+		assert(readers[t].found == 1000);
+	}
+#endif
+
+	// Thawed objects go back to scanning, copies are never frozen
+	json_value copy;
+	json_clone(&copy, &root);
+	assert(copy.flags == 0);
+	assert(json_test_all_flagged(&copy, JSON_FLAG_FROZEN, 0));
+	json_thaw(&root);
+	assert(root.flags == 0);
+	assert(json_test_all_flagged(&root, JSON_FLAG_FROZEN, 0));
+	assert(json_value_to_double(json_value_with_key(&root, "k17")) == 17);
+	assert(json_equal(&copy, &root));
+
+	json_free_value(&copy);
+	json_free_value(&plain);
+	json_free_value(&root);
+	vector_free(&text);
+	printf(" OK\n");
+}
+
+void json_test_sorted_keys(void)
+{
+	printf("json_test_sorted_keys: ");
+
+	json_parse_options sorted = { .flags = JSON_PARSE_SORTED_KEYS };
+	json_value a, b, plain;
+	const char* input = "{\"m\":1,\"b\":{\"z\":[{\"y\":1,\"x\":2}],\"a\":{}},\"x\":2,\"b\":3,\"\":4,\"ba\":5}";
+	assert(json_parse_ex(input, &a, &sorted));
+	assert(json_parse(input, &plain));
+	assert(a.flags == JSON_FLAG_SORTED_KEYS);
+	assert(json_equal(&a, &plain));
+
+	char* text = json_serialize(&a);
+	assert(strcmp(text, "{\"\":4,\"b\":{\"a\":{},\"z\":[{\"x\":2,\"y\":1}]},\"b\":3,\"ba\":5,\"m\":1,\"x\":2}") == 0);
+	free(text);
+	assert(json_object_source_position(&a, 0) == 4);
+	assert(json_object_source_position(&a, 1) == 1);
+	assert(json_object_source_position(&a, 2) == 3);
+
+	// Binary search finds the first of duplicated keys
+	assert(json_value_with_key(&a, "b")->type == JSON_TYPE_OBJECT);
+	assert(json_value_to_double(json_value_with_key(&a, "")) == 4);
+	assert(json_value_to_double(json_value_with_key(&a, "x")) == 2);
+	assert(json_value_with_key(&a, "bb") == NULL);
+	assert(json_value_with_key(&a, "a") == NULL);
+	assert(json_value_with_key(&a, "y") == NULL);
+	assert(json_value_with_key_hashed(&a, "bar", 2, json_key_hash("ba", 2)) == json_value_with_key(&a, "ba"));
+
+#ifdef JSON_STATS
+	// Room for the positions is made while the members are added, sorting grows nothing.
+	// 252 values fill a vector of 256, the positions wouldn't fit behind them
+	vector wide;
+	vector_init(&wide, sizeof(char));
+	for (int i = 0; i < 126; ++i) {
+		char member[16];
+		vector_append(&wide, member, (size_t)sprintf(member, "%c\"k%d\":%d", i ? ',' : '{', 125 - i, i));
+	}
+	vector_append(&wide, "}", 2);
+	json_parse_stats plain_stats, sorted_stats;
+	json_value wide_plain, wide_sorted;
+	json_stats_reset_global();
+	assert(json_parse(wide.data, &wide_plain));
+	json_stats_global(&plain_stats);
+	json_stats_reset_global();
+	assert(json_parse_ex(wide.data, &wide_sorted, &sorted));
+	json_stats_global(&sorted_stats);
+	assert(sorted_stats.reallocations <= plain_stats.reallocations);
+	assert(json_equal(&wide_plain, &wide_sorted));
+	json_free_value(&wide_plain);
+	json_free_value(&wide_sorted);
+	vector_free(&wide);
+#endif
+
+	// Clones stay sorted, restoring gives back the input order
+	json_value copy;
+	json_clone(&copy, &a);
+	assert(copy.flags == JSON_FLAG_SORTED_KEYS);
+	json_restore_order(&copy);
+	assert(copy.flags == 0);
+	char* expected = json_serialize(&plain);
+	text = json_serialize(&copy);
+	assert(strcmp(text, expected) == 0);
+	free(text);
+	free(expected);
+	json_free_value(&copy);
+
+	// Walking two objects side by side
+	assert(json_parse_ex("{\"x\":20,\"c\":0,\"b\":true,\"n\":null}", &b, &sorted));
+	json_object_join join;
+	json_object_join_init(&join, &a, &b);
+	const char* key;
+	const json_value* left;
+	const json_value* right;
+	char walk[64] = "";
+	while (json_object_join_next(&join, &key, &left, &right)) {
+		strcat(walk, key);
+		strcat(walk, left && right ? "=" : left ? "<" : ">");
+	}
+	assert(strcmp(walk, "<b=b<ba<c>m<n>x=") == 0);
+
+	json_free_value(&a);
+	json_free_value(&b);
+	json_free_value(&plain);
+
+	// Empty and single member objects and a warm document
+	json_document doc;
+	json_document_init(&doc);
+	assert(json_document_parse_ex(&doc, "[{}, {\"k\":[]}, {\"b\":1,\"a\":2}]", &sorted));
+	assert(json_get_at(&doc.root, 0)->flags == JSON_FLAG_SORTED_KEYS);
+	assert(json_value_with_key(json_get_at(&doc.root, 1), "k") != NULL);
+	assert(json_document_parse_ex(&doc, "[{\"d\":1,\"c\":2,\"b\":3,\"a\":4}]", &sorted));
+	assert(json_value_to_double(json_value_with_key(json_get_at(&doc.root, 0), "c")) == 2);
+	assert(json_object_source_position(json_get_at(&doc.root, 0), 0) == 3);
+	json_document_free(&doc);
+
+	printf(" OK\n");
+}
 
 void json_test_all(void)
 {
@@ -592,6 +2601,19 @@ void json_test_all(void)
 	json_test_value_object();
 	json_test_value_literal();
 	json_test_coarse();
+	json_test_strict();
+	json_test_strict_utf8();
+	json_test_projection();
+	json_test_lazy_numbers();
+	json_test_serialize();
+	json_test_accessors();
+	json_test_document();
+	json_test_equal_hash_clone();
+	json_test_freeze();
+	json_test_sorted_keys();
+#ifdef JSON_STATS
+	json_test_stats();
+#endif
 }
 
 
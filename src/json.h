@@ -1,8 +1,19 @@
 #ifndef HS_JSON_H
 #define HS_JSON_H
 
+#include <stdint.h>
+
 #include "vector.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Deepest nesting of arrays and objects accepted, protects the recursive parser's stack
+#ifndef JSON_MAX_DEPTH
+#define JSON_MAX_DEPTH 1024
+#endif
+
 enum json_value_type {
 	JSON_TYPE_NULL,
 	JSON_TYPE_BOOL,
@@ -12,8 +23,17 @@ enum json_value_type {
 	JSON_TYPE_STRING
 };
 
+enum json_value_flags {
+	JSON_FLAG_NUMBER_TEXT = 1, // value.raw.text holds the number as it appeared in the input
+	JSON_FLAG_NUMBER_PENDING = 2, // value.raw.value has not been converted yet
+	JSON_FLAG_FROZEN = 4, // Part of a tree passed to json_freeze, set on every value
+	JSON_FLAG_KEY_INDEX = 8, // Object with a key index behind its members, see json_freeze
+	JSON_FLAG_SORTED_KEYS = 16 // Object with members sorted by key, see JSON_PARSE_SORTED_KEYS
+};
+
 typedef struct {
 	int type;
+	unsigned flags; // json_value_flags
 	union {
 		int boolean;
 		double number;
@@ -21,6 +41,11 @@ typedef struct {
 		char* key;
 		vector array;
 		vector object;
+		struct {
+			double value; // Same storage as number
+			const char* text; // Points into the parsed input, not terminated
+			size_t length;
+		} raw;
 	} value;
 } json_value;
 
@@ -28,9 +53,145 @@ typedef struct {
 // return 1 if successful.
 int json_parse(const char* input, json_value* root);
 
+enum json_parse_flags {
+	JSON_PARSE_STRICT_UTF8 = 1, // Reject strings that are not well formed UTF-8
+	// Keep numbers as their source text and convert on first access through
+	// json_get_double, json_get_int64 or json_value_to_double. The input has to
+	// outlive the tree, value.number must not be read directly before conversion
+	JSON_PARSE_LAZY_NUMBERS = 2,
+	// Sort the members of every object by key (strcmp order, duplicates keep their order)
+	// so lookups are binary searches and two objects can be walked side by side with
+	// json_object_join. The insertion order is kept, see json_object_source_position.
+	// Adding or removing members of a sorted object drops the sorted state
+	JSON_PARSE_SORTED_KEYS = 4
+};
+
+// Set of key paths to materialize, everything else is checked but skipped without
+// allocating. Paths use JSON Pointer syntax e.g. "/a/b", "" selects everything.
+// Arrays are transparent, the paths apply to each element. Selected members keep
+// their values even if the value is not an object
+typedef struct {
+	char* key; // NULL for the root
+	size_t key_length;
+	int keep_all; // The whole subtree is selected
+	vector children;
+} json_projection;
+
+void json_projection_init(json_projection* projection);
+
+// Add a path, return 0 if it is malformed
+int json_projection_add(json_projection* projection, const char* path);
+
+void json_projection_free(json_projection* projection);
+
+typedef struct {
+	unsigned flags; // json_parse_flags
+	const json_projection* projection; // NULL keeps everything
+} json_parse_options;
+
+// json_parse with options, NULL options is the same as json_parse
+int json_parse_ex(const char* input, json_value* root, const json_parse_options* options);
+
+// A document keeps the memory of its tree when it is cleared. The next parse
+// reuses container storage and string buffers in the order the previous tree
+// used them, so documents of similar shape are parsed without allocating
+typedef struct {
+	json_value root;
+	vector containers; // Spare container vectors, next one at next_container
+	vector strings; // String buffers with their sizes, the spare ones start at next_string
+	size_t next_container;
+	size_t next_string;
+	vector containers_scratch;
+	vector strings_scratch;
+} json_document;
+
+void json_document_init(json_document* doc);
+
+// Clear doc and parse input into doc->root, return 1 if successful
+int json_document_parse(json_document* doc, const char* input);
+
+int json_document_parse_ex(json_document* doc, const char* input, const json_parse_options* options);
+
+// Release the tree into the document's spare memory, nothing is freed
+void json_document_clear(json_document* doc);
+
+// Free the tree and all the spare memory
+void json_document_free(json_document* doc);
+
+#ifdef JSON_STATS
+
+// Counters for one parse, only available when built with JSON_STATS
+typedef struct {
+	size_t bytes; // Input consumed
+	size_t values[JSON_TYPE_STRING + 1]; // Per json_value_type, object keys count as strings
+	size_t max_depth;
+	size_t string_bytes; // Copied into string values
+	size_t allocations; // Container vectors and strings
+	size_t reallocations; // Container growth in vector_reserve
+	double parse_seconds; // Wall time spent building the tree, from a monotonic clock
+} json_parse_stats;
+
+// Like json_parse, fills stats if it is not NULL
+int json_parse_with_stats(const char* input, json_value* root, json_parse_stats* stats);
+
+// Totals over all parses since startup or the last reset, max_depth is the deepest
+// document seen. Updates are relaxed atomic operations done once per parse, safe to
+// call from any thread
+void json_stats_global(json_parse_stats* stats);
+
+void json_stats_reset_global(void);
+
+#endif
+
+// Write value as compact JSON, the result is allocated with malloc
+char* json_serialize(const json_value* value);
+
 // Free the structure and all the allocated values
 void json_free_value(json_value* val);
 
+enum json_freeze_flags {
+	JSON_FREEZE_INDEX = 1 // Build key indexes for objects of JSON_INDEX_MIN_MEMBERS or more, sorted objects are searched as they are
+};
+
+// Objects smaller than this are scanned, which is as fast as hashing the key
+#ifndef JSON_INDEX_MIN_MEMBERS
+#define JSON_INDEX_MIN_MEMBERS 8
+#endif
+
+// Make root a frozen tree that is only read from then on, so any number of threads can
+// share it without locking. Lazily parsed numbers are converted and, with
+// JSON_FREEZE_INDEX, objects get a key index that json_value_with_key uses. Nothing is
+// written by lookups or the json_get_* accessors afterwards. The indexes are built on
+// up to threads threads when built with JSON_THREADS, the calling thread otherwise.
+// Every value in the tree is marked JSON_FLAG_FROZEN, so the functions of json_patch.h
+// assert on any part of it
+void json_freeze(json_value* root, unsigned flags, unsigned threads);
+
+// Drop the frozen state and the key indexes so the tree can be modified again. The
+// memory of the indexes is kept until the objects are freed
+void json_thaw(json_value* root);
+
+// Structural equality, the order of object members doesn't matter. Objects whose
+// keys are in the same order are compared in a single pass. Numbers compare by value,
+// duplicated keys are paired up in order
+int json_equal(const json_value* a, const json_value* b);
+
+// Hash consistent with json_equal. An object hashes to a seed plus the sum of
+// json_hash_member over its members, so adding, removing or replacing one member
+// updates the hash by the difference without touching the others
+uint64_t json_hash(const json_value* value);
+
+uint64_t json_hash_member(const char* key, const json_value* value);
+
+// Deep copy src into dst, every container and string is allocated once at its final
+// size. Lazily parsed numbers keep pointing into the input src was parsed from, copies
+// of frozen trees are not frozen
+void json_clone(json_value* dst, const json_value* src);
+
+// Like json_clone into doc->root, using the document's spare memory. src must not be
+// part of doc
+void json_document_clone(json_document* doc, const json_value* src);
+
 // Convert value to string if possible, asserts if not
 char* json_value_to_string(json_value* value);
 
@@ -47,14 +208,156 @@ vector* json_value_to_array(json_value* value);
 vector* json_value_to_object(json_value* value);
 
 // Fetch the value with given index from root, asserts if root is not array
+// return NULL if index is out of range
 json_value* json_value_at(const json_value* root, size_t index);
 
 // Fetche the value with the given key from root, asserts if root is not object
 json_value * json_value_with_key(const json_value * root, const char * key);
 
+// 64 bit FNV-1a of a key, the C++ wrapper computes the same hash at compile time
+static inline uint64_t json_key_hash(const char* key, size_t length)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < length; ++i) {
+		hash ^= (unsigned char)key[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// Like json_value_with_key for a key that is not NUL terminated, hash must be
+// json_key_hash(key, length). Returns NULL if root is not an object
+json_value* json_value_with_key_hashed(const json_value* root, const char* key, size_t length, uint64_t hash);
+
+// Position a member of a sorted object had in the input, member counts key value pairs.
+// The positions are stored behind the members
+static inline size_t json_object_source_position(const json_value* object, size_t member)
+{
+	const uint32_t* positions = (const uint32_t*)(object->value.object.data + object->value.object.size * sizeof(json_value));
+	return positions[member];
+}
+
+// Put the members of sorted objects in root back into input order, e.g. for serializing
+void json_restore_order(json_value* root);
+
+// Merge join over two sorted objects, yields every key in order together with its
+// value in a and in b. Duplicate keys are paired up in order
+typedef struct {
+	const json_value* a;
+	const json_value* b;
+	size_t a_next;
+	size_t b_next;
+} json_object_join;
+
+void json_object_join_init(json_object_join* join, const json_value* a, const json_value* b);
+
+// Next key, a_value or b_value is NULL if the key is only in the other object.
+// Returns 0 once both objects are exhausted
+int json_object_join_next(json_object_join* join, const char** key, const json_value** a_value, const json_value** b_value);
+
+// Checked accessors, these don't assert. Each returns 1 and stores the value in out
+// if value is not NULL and has the right type, otherwise returns 0 and leaves out alone.
+// Passing NULL is allowed so lookups can be chained
+
+static inline int json_get_bool(const json_value* value, int* out)
+{
+	if (!value || value->type != JSON_TYPE_BOOL) return 0;
+	*out = value->value.boolean;
+	return 1;
+}
+
+// Convert a lazily parsed number and cache the result in value
+void json_number_materialize(json_value* value);
+
+// Numeric value without caching, for lazily parsed numbers that must not be modified
+double json_number_value(const json_value* value);
+
+// Integer value of a number that kept its source text. Plain integers are converted
+// exactly, text with a fraction or exponent like 1.0 or 1e2 goes through the double
+// as for eagerly parsed numbers. 0 if there is no text or it is not an integer in
+// the range of int64_t
+int json_number_text_int64(const json_value* value, int64_t* out);
+
+// 0 if number has a fractional part or is outside the range of int64_t
+static inline int json_double_to_int64(double number, int64_t* out)
+{
+	// 2^63 is exact as a double, the negation of it is INT64_MIN
+	if (!(number >= -9223372036854775808.0 && number < 9223372036854775808.0)) return 0;
+	int64_t integer = (int64_t)number;
+	if ((double)integer != number) return 0;
+	*out = integer;
+	return 1;
+}
+
+// A lazily converted number is cached on first access, which writes to value
+static inline int json_get_double(const json_value* value, double* out)
+{
+	if (!value || value->type != JSON_TYPE_NUMBER) return 0;
+	if (value->flags & JSON_FLAG_NUMBER_PENDING) json_number_materialize((json_value*)value);
+	*out = value->value.number;
+	return 1;
+}
+
+// Fails for numbers with a fractional part or outside the range of int64_t. Numbers
+// that kept their text are converted from it, so large integers stay exact
+static inline int json_get_int64(const json_value* value, int64_t* out)
+{
+	if (!value || value->type != JSON_TYPE_NUMBER) return 0;
+	if (value->flags & JSON_FLAG_NUMBER_TEXT) return json_number_text_int64(value, out);
+	return json_double_to_int64(value->value.number, out);
+}
+
+// The number exactly as written in the input, only for numbers parsed with JSON_PARSE_LAZY_NUMBERS
+static inline int json_get_number_text(const json_value* value, const char** text, size_t* length)
+{
+	if (!value || value->type != JSON_TYPE_NUMBER || !(value->flags & JSON_FLAG_NUMBER_TEXT)) return 0;
+	*text = value->value.raw.text;
+	*length = value->value.raw.length;
+	return 1;
+}
+
+static inline int json_get_string(const json_value* value, const char** out)
+{
+	if (!value || value->type != JSON_TYPE_STRING) return 0;
+	*out = value->value.string;
+	return 1;
+}
+
+// Element at index or NULL if root is not an array or index is out of range
+static inline const json_value* json_get_at(const json_value* root, size_t index)
+{
+	if (!root || root->type != JSON_TYPE_ARRAY || index >= root->value.array.size) return NULL;
+	return (const json_value*)root->value.array.data + index;
+}
+
+// Follow count keys down from root, NULL if any step is missing or not an object
+static inline const json_value* json_get_pathv(const json_value* root, const char* const* keys, size_t count)
+{
+	for (size_t i = 0; i < count && root; ++i) {
+		if (root->type != JSON_TYPE_OBJECT) return NULL;
+		root = json_value_with_key(root, keys[i]);
+	}
+	return root;
+}
+
+// Path lookups with the keys as arguments e.g.
+//   double d;
+//   if (json_get_path_double(&root, &d, "a", "b")) ...
+#define JSON_PATH_KEYS(...) \
+	(const char* const[]){ __VA_ARGS__ }, sizeof((const char* const[]){ __VA_ARGS__ }) / sizeof(const char*)
+#define json_get_path(root, ...) json_get_pathv((root), JSON_PATH_KEYS(__VA_ARGS__))
+#define json_get_path_bool(root, out, ...) json_get_bool(json_get_path((root), __VA_ARGS__), (out))
+#define json_get_path_double(root, out, ...) json_get_double(json_get_path((root), __VA_ARGS__), (out))
+#define json_get_path_int64(root, out, ...) json_get_int64(json_get_path((root), __VA_ARGS__), (out))
+#define json_get_path_string(root, out, ...) json_get_string(json_get_path((root), __VA_ARGS__), (out))
+
 #ifdef BUILD_TEST
 void json_test_all(void);
 #endif 
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
 
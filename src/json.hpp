@@ -0,0 +1,283 @@
+#ifndef HS_JSON_HPP
+#define HS_JSON_HPP
+
+// Header only C++17 layer over json.h. Document owns a parsed tree and frees it,
+// ValueRef is a non-owning view into it that is cheap to copy. Lookups on missing
+// keys, wrong types or out of range indexes give an empty ValueRef instead of
+// asserting so they can be chained e.g.
+//   json::Document doc;
+//   if (doc.parse(text)) {
+//       auto name = doc["user"]["name"].as_string();
+//       for (json::ValueRef item : doc["items"]) ...
+//       for (auto member : doc["user"].members()) ...
+//   }
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "json.h"
+
+namespace json {
+
+// Same as json_key_hash, usable in constant expressions
+constexpr uint64_t key_hash(std::string_view key)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : key) {
+		hash ^= (unsigned char)c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// Object key with its hash. Literal keys are folded by the optimizer, a constexpr
+// Key is hashed at compile time regardless of the optimization level
+struct Key {
+	std::string_view name;
+	uint64_t hash;
+
+	constexpr Key(std::string_view key) : name(key), hash(key_hash(key)) {}
+	constexpr Key(const char* key) : Key(std::string_view(key)) {}
+	Key(const std::string& key) : Key(std::string_view(key)) {}
+};
+
+namespace literals {
+constexpr Key operator""_key(const char* key, std::size_t length)
+{
+	return Key(std::string_view(key, length));
+}
+}
+
+class ValueRef {
+public:
+	class Iterator;
+	class Members;
+
+	ValueRef() = default;
+	explicit ValueRef(const json_value* value) : value_(value) {}
+
+	// The underlying value, NULL if the lookup that produced this failed
+	const json_value* get() const { return value_; }
+	explicit operator bool() const { return value_ != nullptr; }
+
+	bool is_null() const { return is(JSON_TYPE_NULL); }
+	bool is_bool() const { return is(JSON_TYPE_BOOL); }
+	bool is_number() const { return is(JSON_TYPE_NUMBER); }
+	bool is_string() const { return is(JSON_TYPE_STRING); }
+	bool is_array() const { return is(JSON_TYPE_ARRAY); }
+	bool is_object() const { return is(JSON_TYPE_OBJECT); }
+
+	// Same rules as the json_get_* accessors, empty on a type mismatch
+	std::optional<bool> as_bool() const
+	{
+		int out;
+		if (!json_get_bool(value_, &out)) return std::nullopt;
+		return out != 0;
+	}
+
+	std::optional<double> as_double() const
+	{
+		double out;
+		if (!json_get_double(value_, &out)) return std::nullopt;
+		return out;
+	}
+
+	std::optional<int64_t> as_int64() const
+	{
+		int64_t out;
+		if (!json_get_int64(value_, &out)) return std::nullopt;
+		return out;
+	}
+
+	std::optional<std::string_view> as_string() const
+	{
+		const char* out;
+		if (!json_get_string(value_, &out)) return std::nullopt;
+		return std::string_view(out);
+	}
+
+	// Number as written in the input, only with JSON_PARSE_LAZY_NUMBERS
+	std::optional<std::string_view> number_text() const
+	{
+		const char* text;
+		size_t length;
+		if (!json_get_number_text(value_, &text, &length)) return std::nullopt;
+		return std::string_view(text, length);
+	}
+
+	ValueRef operator[](const Key& key) const
+	{
+		return ValueRef(json_value_with_key_hashed(value_, key.name.data(), key.name.size(), key.hash));
+	}
+
+	ValueRef operator[](size_t index) const { return ValueRef(json_get_at(value_, index)); }
+
+	// Elements of an array or members of an object, 0 for everything else
+	size_t size() const
+	{
+		if (is_array()) return value_->value.array.size;
+		if (is_object()) return value_->value.object.size / 2;
+		return 0;
+	}
+
+	// Range-for over array elements, nothing for other types
+	Iterator begin() const;
+	Iterator end() const;
+
+	// Range-for over object members in document order, nothing for other types
+	Members members() const;
+
+private:
+	bool is(int type) const { return value_ && value_->type == type; }
+
+	const json_value* value_ = nullptr;
+};
+
+struct Member {
+	std::string_view key;
+	ValueRef value;
+};
+
+class ValueRef::Iterator {
+public:
+	explicit Iterator(const json_value* at) : at_(at) {}
+	ValueRef operator*() const { return ValueRef(at_); }
+	Iterator& operator++() { ++at_; return *this; }
+	bool operator==(const Iterator& other) const { return at_ == other.at_; }
+	bool operator!=(const Iterator& other) const { return at_ != other.at_; }
+
+private:
+	const json_value* at_;
+};
+
+class ValueRef::Members {
+public:
+	// Keys and values are interleaved in the object's vector
+	class Iterator {
+	public:
+		explicit Iterator(const json_value* at) : at_(at) {}
+		Member operator*() const { return Member{ at_[0].value.key, ValueRef(at_ + 1) }; }
+		Iterator& operator++() { at_ += 2; return *this; }
+		bool operator==(const Iterator& other) const { return at_ == other.at_; }
+		bool operator!=(const Iterator& other) const { return at_ != other.at_; }
+
+	private:
+		const json_value* at_;
+	};
+
+	Members(const json_value* first, const json_value* last) : first_(first), last_(last) {}
+	Iterator begin() const { return Iterator(first_); }
+	Iterator end() const { return Iterator(last_); }
+
+private:
+	const json_value* first_;
+	const json_value* last_;
+};
+
+inline ValueRef::Iterator ValueRef::begin() const
+{
+	if (!is_array()) return Iterator(nullptr);
+	return Iterator((const json_value*)value_->value.array.data);
+}
+
+inline ValueRef::Iterator ValueRef::end() const
+{
+	if (!is_array()) return Iterator(nullptr);
+	return Iterator((const json_value*)value_->value.array.data + value_->value.array.size);
+}
+
+inline ValueRef::Members ValueRef::members() const
+{
+	if (!is_object()) return Members(nullptr, nullptr);
+	const json_value* first = (const json_value*)value_->value.object.data;
+	return Members(first, first + value_->value.object.size);
+}
+
+// Owns a parsed tree. Move-only, copying would share the vectors and strings of the
+// tree and free them twice
+class Document {
+public:
+	Document()
+	{
+		root_.type = JSON_TYPE_NULL;
+		root_.flags = 0;
+	}
+
+	// Take ownership of a tree built by the C API, value is left empty
+	explicit Document(json_value* value) : root_(*value)
+	{
+		value->type = JSON_TYPE_NULL;
+		value->flags = 0;
+	}
+
+	Document(const Document&) = delete;
+	Document& operator=(const Document&) = delete;
+
+	Document(Document&& other) noexcept : Document(&other.root_) {}
+
+	Document& operator=(Document&& other) noexcept
+	{
+		if (this != &other) {
+			json_free_value(&root_);
+			root_ = other.root_;
+			other.root_.type = JSON_TYPE_NULL;
+			other.root_.flags = 0;
+		}
+		return *this;
+	}
+
+	~Document() { json_free_value(&root_); }
+
+	// Replace the tree with input, on failure the document is empty. With
+	// JSON_PARSE_LAZY_NUMBERS numbers point into input, it has to outlive the document
+	bool parse(const char* input, const json_parse_options* options = nullptr)
+	{
+		json_free_value(&root_);
+		if (json_parse_ex(input, &root_, options)) return true;
+		root_.type = JSON_TYPE_NULL;
+		root_.flags = 0;
+		return false;
+	}
+
+	bool parse(const std::string& input, const json_parse_options* options = nullptr)
+	{
+		return parse(input.c_str(), options);
+	}
+
+	// Make the tree read-only, see json_freeze. A frozen document can be read through
+	// ValueRefs from any number of threads
+	void freeze(unsigned flags = JSON_FREEZE_INDEX, unsigned threads = 1) { json_freeze(&root_, flags, threads); }
+
+	ValueRef root() const { return ValueRef(&root_); }
+	ValueRef operator[](const Key& key) const { return root()[key]; }
+	ValueRef operator[](size_t index) const { return root()[index]; }
+
+	// Compact JSON of the tree
+	std::string serialize() const
+	{
+		char* text = json_serialize(&root_);
+		std::string result(text);
+		free(text);
+		return result;
+	}
+
+	// Give up ownership, the caller has to json_free_value the result
+	json_value release()
+	{
+		json_value value = root_;
+		root_.type = JSON_TYPE_NULL;
+		root_.flags = 0;
+		return value;
+	}
+
+private:
+	json_value root_;
+};
+
+}
+
+#endif
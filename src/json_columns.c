@@ -0,0 +1,360 @@
+#include "json_columns.h"
+#include "json_internal.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void column_init(json_column* column, const char* name)
+{
+	size_t len = strlen(name);
+	column->name = malloc(len + 1);
+	memcpy(column->name, name, len + 1);
+	column->type = JSON_COLUMN_NULL;
+	column->filled = 0;
+	vector_init(&column->values, sizeof(int64_t));
+	vector_init(&column->chars, sizeof(char));
+	vector_init(&column->nulls, sizeof(uint8_t));
+}
+
+static void column_free(json_column* column)
+{
+	free(column->name);
+	vector_free(&column->values);
+	vector_free(&column->chars);
+	vector_free(&column->nulls);
+}
+
+// Append a null for the next row, values get a zero or the empty string
+static void column_push_null(json_column* column)
+{
+	size_t row = column->filled++;
+	uint8_t zero = 0;
+	while (column->nulls.size <= row / 8) vector_push_back(&column->nulls, &zero);
+	((uint8_t*)column->nulls.data)[row / 8] |= (uint8_t)(1u << (row % 8));
+
+	if (column->type != JSON_COLUMN_NULL) {
+		int64_t value = 0; // Large enough for every type, all bits zero is 0, 0.0, false and offset 0
+		vector_push_back(&column->values, &value);
+	}
+}
+
+// Give a column that only had nulls its type, the rows so far become zeros
+static void column_set_type(json_column* column, int type)
+{
+	static const size_t sizes[] = { 0, sizeof(uint8_t), sizeof(int64_t), sizeof(double), sizeof(size_t) };
+	column->type = type;
+	column->values.data_size = sizes[type];
+	int64_t zero = 0;
+	while (column->values.size < column->filled) vector_push_back(&column->values, &zero);
+	if (type == JSON_COLUMN_STRING) {
+		// Null rows point at this empty string
+		vector_push_back(&column->chars, "");
+	}
+}
+
+// Make room for the value of the next row and mark it as present
+static void* column_push(json_column* column)
+{
+	uint8_t zero = 0;
+	size_t row = column->filled++;
+	while (column->nulls.size <= row / 8) vector_push_back(&column->nulls, &zero);
+	int64_t value = 0;
+	vector_push_back(&column->values, &value);
+	return vector_get(&column->values, column->values.size - 1);
+}
+
+static void column_int64_to_double(json_column* column)
+{
+	int64_t* values = (int64_t*)column->values.data;
+	double* doubles = (double*)column->values.data;
+	for (size_t i = 0; i < column->values.size; ++i) doubles[i] = (double)values[i];
+	column->type = JSON_COLUMN_DOUBLE;
+}
+
+static int column_push_number(json_column* column, const char** cursor)
+{
+	const char* start = *cursor;
+	size_t len = json_number_length(start);
+	if (!len) return 0;
+	*cursor += len;
+
+	int integral = 1;
+	for (size_t i = 0; i < len; ++i) {
+		if (start[i] == '.' || start[i] == 'e' || start[i] == 'E') integral = 0;
+	}
+	long long integer = 0;
+	if (integral) {
+		errno = 0;
+		integer = strtoll(start, NULL, 10);
+		if (errno == ERANGE) integral = 0;
+	}
+
+	if (column->type == JSON_COLUMN_NULL) {
+		column_set_type(column, integral ? JSON_COLUMN_INT64 : JSON_COLUMN_DOUBLE);
+	}
+	if (column->type == JSON_COLUMN_INT64 && !integral) {
+		column_int64_to_double(column);
+	}
+
+	if (column->type == JSON_COLUMN_INT64) {
+		*(int64_t*)column_push(column) = integer;
+	}
+	else if (column->type == JSON_COLUMN_DOUBLE) {
+		*(double*)column_push(column) = strtod(start, NULL);
+	}
+	else {
+		return 0;
+	}
+	return 1;
+}
+
+static int column_push_string(json_column* column, const char** cursor)
+{
+	if (column->type == JSON_COLUMN_NULL) column_set_type(column, JSON_COLUMN_STRING);
+	if (column->type != JSON_COLUMN_STRING) return 0;
+
+	size_t offset = column->chars.size;
+	if (!json_decode_string(cursor, &column->chars)) return 0;
+	*(size_t*)column_push(column) = offset;
+	return 1;
+}
+
+static int column_push_bool(json_column* column, uint8_t value)
+{
+	if (column->type == JSON_COLUMN_NULL) column_set_type(column, JSON_COLUMN_BOOL);
+	if (column->type != JSON_COLUMN_BOOL) return 0;
+	*(uint8_t*)column_push(column) = value;
+	return 1;
+}
+
+// Column for key, created and back filled with nulls when it is new. Rows tend to
+// have the same key order so the column at the key's position is tried first
+static json_column* columns_lookup(json_columns* columns, const char* key, size_t position)
+{
+	json_column* items = (json_column*)columns->columns.data;
+	if (position < columns->columns.size && strcmp(items[position].name, key) == 0) {
+		return &items[position];
+	}
+	for (size_t i = 0; i < columns->columns.size; ++i) {
+		if (strcmp(items[i].name, key) == 0) return &items[i];
+	}
+
+	json_column column;
+	column_init(&column, key);
+	while (column.filled < columns->rows) column_push_null(&column);
+	vector_push_back(&columns->columns, &column);
+	return vector_get(&columns->columns, columns->columns.size - 1);
+}
+
+static int parse_row(json_columns* columns, const char** cursor, vector* key)
+{
+	if (!read_char(cursor, '{')) return 0;
+	if (read_char(cursor, '}')) return 1;
+
+	for (size_t position = 0; ; ++position) {
+		key->size = 0;
+		if (!read_char(cursor, '"') || !json_decode_string(cursor, key)) return 0;
+		if (!read_char(cursor, ':')) return 0;
+
+		json_column* column = columns_lookup(columns, key->data, position);
+		if (column->filled > columns->rows) return 0; // Key appears twice in this row
+
+		skip_whitespace(cursor);
+		int success;
+		switch (**cursor) {
+			case '"':
+				++(*cursor);
+				success = column_push_string(column, cursor);
+				break;
+			case 't':
+				success = read_literal(cursor, "true") && column_push_bool(column, 1);
+				break;
+			case 'f':
+				success = read_literal(cursor, "false") && column_push_bool(column, 0);
+				break;
+			case 'n':
+				success = read_literal(cursor, "null");
+				if (success) column_push_null(column);
+				break;
+			default:
+				// Nested arrays and objects end up here and fail
+				success = column_push_number(column, cursor);
+				break;
+		}
+		if (!success) return 0;
+
+		if (read_char(cursor, '}')) return 1;
+		if (!read_char(cursor, ',')) return 0;
+	}
+}
+
+int json_parse_columns(const char* input, json_columns* columns)
+{
+	columns->rows = 0;
+	vector_init(&columns->columns, sizeof(json_column));
+
+	const char* position = input;
+	const char** cursor = &position;
+	vector key;
+	vector_init(&key, sizeof(char));
+
+	int success = read_char(cursor, '[');
+	if (success && !read_char(cursor, ']')) {
+		while (success) {
+			success = parse_row(columns, cursor, &key);
+			if (!success) break;
+
+			// Keys missing from this row are null
+			json_column* items = (json_column*)columns->columns.data;
+			for (size_t i = 0; i < columns->columns.size; ++i) {
+				if (items[i].filled == columns->rows) column_push_null(&items[i]);
+			}
+			++columns->rows;
+
+			if (read_char(cursor, ']')) break;
+			success = read_char(cursor, ',');
+		}
+	}
+	skip_whitespace(cursor);
+	success = success && **cursor == '\0';
+
+	vector_free(&key);
+	if (!success) json_columns_free(columns);
+	return success;
+}
+
+void json_columns_free(json_columns* columns)
+{
+	if (!columns) return;
+	vector_foreach(&columns->columns, (void(*)(void*))column_free);
+	vector_free(&columns->columns);
+	columns->rows = 0;
+}
+
+json_column* json_columns_find(const json_columns* columns, const char* name)
+{
+	json_column* items = (json_column*)columns->columns.data;
+	for (size_t i = 0; i < columns->columns.size; ++i) {
+		if (strcmp(items[i].name, name) == 0) return &items[i];
+	}
+	return NULL;
+}
+
+#ifdef BUILD_TEST
+
+#include <stdio.h>
+
+void json_columns_test_basic(void)
+{
+	printf("json_columns_test_basic: ");
+	json_columns columns;
+	assert(json_parse_columns(" [ {\"ts\" : 1, \"v\" : 2.5, \"host\" : \"a\", \"ok\" : true}, "
+		"{\"ts\" : 2, \"v\" : 3, \"host\" : \"b\\n\", \"ok\" : false}, "
+		"{\"v\" : null, \"ts\" : 3, \"host\" : null, \"extra\" : \"x\"} ] ", &columns));
+	assert(columns.rows == 3);
+	assert(columns.columns.size == 5);
+
+	json_column* ts = json_columns_find(&columns, "ts");
+	assert(ts->type == JSON_COLUMN_INT64);
+	assert(json_column_int64s(ts)[2] == 3);
+	assert(json_column_doubles(ts) == NULL);
+
+	json_column* v = json_columns_find(&columns, "v");
+	assert(v->type == JSON_COLUMN_DOUBLE);
+	assert(json_column_doubles(v)[0] == 2.5 && json_column_doubles(v)[1] == 3.0);
+	assert(!json_column_is_null(v, 1) && json_column_is_null(v, 2));
+
+	json_column* host = json_columns_find(&columns, "host");
+	assert(strcmp(json_column_string(host, 1), "b\n") == 0);
+	assert(json_column_is_null(host, 2) && strcmp(json_column_string(host, 2), "") == 0);
+
+	json_column* ok = json_columns_find(&columns, "ok");
+	assert(ok->type == JSON_COLUMN_BOOL);
+	assert(((uint8_t*)ok->values.data)[0] == 1 && json_column_is_null(ok, 2));
+
+	// Back filled for the rows before it appeared
+	json_column* extra = json_columns_find(&columns, "extra");
+	assert(extra->values.size == 3);
+	assert(json_column_is_null(extra, 0) && json_column_is_null(extra, 1) && !json_column_is_null(extra, 2));
+	assert(strcmp(json_column_string(extra, 2), "x") == 0);
+	assert(json_columns_find(&columns, "missing") == NULL);
+
+	json_columns_free(&columns);
+	printf(" OK\n");
+}
+
+void json_columns_test_types(void)
+{
+	printf("json_columns_test_types: ");
+	json_columns columns;
+
+	// Integers turn into doubles when needed, nulls before the first value become zeros
+	assert(json_parse_columns("[{\"a\":null},{\"a\":1},{\"a\":1e1},{\"a\":99999999999999999999}]", &columns));
+	json_column* a = json_columns_find(&columns, "a");
+	assert(a->type == JSON_COLUMN_DOUBLE);
+	assert(json_column_doubles(a)[0] == 0.0 && json_column_is_null(a, 0));
+	assert(json_column_doubles(a)[1] == 1.0 && json_column_doubles(a)[2] == 10.0);
+	json_columns_free(&columns);
+
+	// Many rows to cross bitmap bytes and vector growth
+	char input[4096] = "[";
+	for (int i = 0; i < 100; ++i) {
+		char row[32];
+		snprintf(row, sizeof(row), (i % 3) ? "{\"n\":%d}," : "{},", i);
+		strcat(input, row);
+	}
+	input[strlen(input) - 1] = ']';
+	assert(json_parse_columns(input, &columns));
+	assert(columns.rows == 100);
+	json_column* n = json_columns_find(&columns, "n");
+	for (int i = 0; i < 100; ++i) {
+		assert(json_column_is_null(n, i) == (i % 3 == 0));
+		if (i % 3) assert(json_column_int64s(n)[i] == i);
+	}
+	json_columns_free(&columns);
+
+	// Values grow by doubling like every other vector, a power of two capacity means
+	// log2(rows) reallocations rather than one per row
+	size_t rows = 5000;
+	char* large = malloc(rows * 48 + 2);
+	char* end = large;
+	*end++ = '[';
+	for (size_t i = 0; i < rows; ++i) {
+		end += sprintf(end, (i < 10) ? "{\"i\":%zu,\"b\":true}," : "{\"i\":%zu,\"b\":true,\"s\":\"x\",\"d\":0.5},", i);
+	}
+	end[-1] = ']';
+	assert(json_parse_columns(large, &columns));
+	free(large);
+	assert(columns.rows == rows);
+	const char* names[] = { "i", "b", "s", "d" };
+	for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+		size_t capacity = json_columns_find(&columns, names[i])->values.capacity;
+		assert(capacity >= rows && capacity < 2 * rows);
+		assert((capacity & (capacity - 1)) == 0);
+	}
+	json_columns_free(&columns);
+
+	assert(json_parse_columns("[]", &columns));
+	assert(columns.rows == 0);
+	json_columns_free(&columns);
+
+	const char* invalid[] = {
+		"{}", "[1]", "[{\"a\":1},{\"a\":\"s\"}]", "[{\"a\":[1]}]", "[{\"a\":{}}]", "[{\"a\":1,\"a\":2}]",
+		"[{\"a\":1},]", "[{\"a\":1}] x", "[{\"a\":01}]", "[{\"a\":\"\\x\"}]", "[{\"a\":1}"
+	};
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+		assert(!json_parse_columns(invalid[i], &columns));
+		assert(columns.columns.data == NULL);
+	}
+	printf(" OK\n");
+}
+
+void json_columns_test_all(void)
+{
+	json_columns_test_basic();
+	json_columns_test_types();
+}
+
+#endif
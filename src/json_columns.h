@@ -0,0 +1,78 @@
+#ifndef HS_JSON_COLUMNS_H
+#define HS_JSON_COLUMNS_H
+
+#include <stdint.h>
+
+#include "vector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Columnar parsing of an array of flat objects e.g. [{"ts":1,"v":2.5,"host":"a"}, ...]
+// Every key becomes one column with its name stored once, the values of all rows
+// are stored contiguously
+
+enum json_column_type {
+	JSON_COLUMN_NULL, // Only nulls seen so far, values is empty
+	JSON_COLUMN_BOOL, // uint8_t per row
+	JSON_COLUMN_INT64, // int64_t per row, becomes DOUBLE once a number doesn't fit
+	JSON_COLUMN_DOUBLE, // double per row
+	JSON_COLUMN_STRING // size_t offset per row into chars, each string is NUL terminated
+};
+
+typedef struct {
+	char* name;
+	int type;
+	vector values;
+	vector chars;
+	vector nulls; // uint8_t bitmap, bit row % 8 of byte row / 8 is set if the row is null or missing
+	size_t filled; // Rows written so far
+} json_column;
+
+typedef struct {
+	size_t rows;
+	vector columns; // json_column in order of first appearance
+} json_columns;
+
+// Parse input into columns, return 1 if successful. Fails if input is not an array
+// of objects, if a value is an array or object or if a column mixes types, numbers
+// of both kinds are fine
+int json_parse_columns(const char* input, json_columns* columns);
+
+void json_columns_free(json_columns* columns);
+
+// Column with the given name or NULL
+json_column* json_columns_find(const json_columns* columns, const char* name);
+
+static inline int json_column_is_null(const json_column* column, size_t row)
+{
+	return (((const uint8_t*)column->nulls.data)[row / 8] >> (row % 8)) & 1;
+}
+
+static inline const double* json_column_doubles(const json_column* column)
+{
+	return column->type == JSON_COLUMN_DOUBLE ? (const double*)column->values.data : NULL;
+}
+
+static inline const int64_t* json_column_int64s(const json_column* column)
+{
+	return column->type == JSON_COLUMN_INT64 ? (const int64_t*)column->values.data : NULL;
+}
+
+// String in row, empty for null rows, NULL if the column doesn't hold strings
+static inline const char* json_column_string(const json_column* column, size_t row)
+{
+	if (column->type != JSON_COLUMN_STRING) return NULL;
+	return column->chars.data + ((const size_t*)column->values.data)[row];
+}
+
+#ifdef BUILD_TEST
+void json_columns_test_all(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,114 @@
+#include "json.hpp"
+
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+using namespace json::literals;
+
+static_assert(!std::is_copy_constructible<json::Document>::value, "Document must not be copyable");
+static_assert(std::is_nothrow_move_constructible<json::Document>::value, "Document must be movable");
+
+// Literal keys are hashed at compile time
+static_assert("name"_key.hash == json::key_hash("name"), "");
+static_assert(json::Key("").hash == 14695981039346656037ull, "");
+
+static void json_hpp_test_access()
+{
+	printf("json_hpp_test_access: ");
+
+	json::Document doc;
+	assert(doc.parse("{ \"user\" : { \"name\" : \"Ann\", \"age\" : 41, \"admin\" : false }, \"items\" : [1, 2.5, \"x\"] }"));
+
+	assert(doc["user"]["name"].as_string() == std::string_view("Ann"));
+	assert(doc["user"]["age"].as_int64() == 41);
+	assert(doc["user"]["admin"].as_bool() == false);
+	assert(doc["items"].size() == 3);
+	assert(doc["items"][1].as_double() == 2.5);
+	assert(!doc["items"][1].as_int64());
+
+	// Missing keys and wrong types chain into empty references
+	assert(!doc["user"]["missing"]["deeper"]);
+	assert(!doc["items"]["name"]);
+	assert(!doc["user"][0]);
+	assert(!doc["items"][3]);
+	assert(!doc["user"].as_string());
+
+	constexpr json::Key age("age");
+	std::string name = "name";
+	assert(doc["user"][age].as_int64() == 41);
+	assert(doc["user"][name].as_string() == std::string_view("Ann"));
+
+	double sum = 0;
+	int strings = 0;
+	for (json::ValueRef item : doc["items"]) {
+		if (auto number = item.as_double()) sum += *number;
+		if (item.is_string()) ++strings;
+	}
+	assert(sum == 3.5 && strings == 1);
+
+	std::string keys;
+	for (json::Member member : doc["user"].members()) {
+		keys += member.key;
+		keys += member.value.is_number() ? "#" : ",";
+	}
+	assert(keys == "name,age#admin,");
+
+	doc.freeze(JSON_FREEZE_INDEX, 2);
+	assert(doc["user"][age].as_int64() == 41);
+	assert(doc["items"][2].as_string() == std::string_view("x"));
+
+	// Nothing to iterate for scalars and missing values
+	for (json::ValueRef item : doc["user"]["name"]) { (void)item; assert(false); }
+	for (json::Member member : doc["nope"].members()) { (void)member; assert(false); }
+
+	printf(" OK\n");
+}
+
+static void json_hpp_test_ownership()
+{
+	printf("json_hpp_test_ownership: ");
+
+	json::Document a;
+	assert(a.parse(std::string("[\"moved\", {\"k\" : null}]")));
+	json::Document b(std::move(a));
+	assert(a.root().is_null());
+	assert(b[0].as_string() == std::string_view("moved"));
+	assert(b[1]["k"].is_null());
+
+	// Assignment frees the old tree, a failed parse leaves an empty document
+	json::Document c;
+	assert(c.parse("{\"old\" : [1, 2, 3]}"));
+	c = std::move(b);
+	assert(c.serialize() == "[\"moved\",{\"k\":null}]");
+	assert(!c.parse("[1, 2"));
+	assert(c.root().is_null());
+
+	// Round trip through the C API
+	assert(c.parse("{\"n\" : 12345678901234567890}"));
+	json_value raw = c.release();
+	assert(c.root().is_null());
+	json::Document d(&raw);
+	assert(raw.type == JSON_TYPE_NULL);
+	assert(d["n"].as_double() == 12345678901234567890.0);
+
+	// Lazy numbers keep their text, the input outlives the document
+	const char* input = "[12345678901234567890, 1.50]";
+	json_parse_options options = { JSON_PARSE_LAZY_NUMBERS, nullptr };
+	json::Document lazy;
+	assert(lazy.parse(input, &options));
+	assert(lazy[0].number_text() == std::string_view("12345678901234567890"));
+	assert(lazy[1].number_text() == std::string_view("1.50"));
+	assert(lazy[1].as_double() == 1.5);
+
+	printf(" OK\n");
+}
+
+int main()
+{
+	json_hpp_test_access();
+	json_hpp_test_ownership();
+	return 0;
+}
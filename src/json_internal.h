@@ -0,0 +1,70 @@
+#ifndef HS_JSON_INTERNAL_H
+#define HS_JSON_INTERNAL_H
+
+// Helpers shared by the parsers and the tree functions, not part of the public interface
+
+#include <stdint.h>
+#include <string.h>
+
+#include "vector.h"
+
+// JSON whitespace, only space, tab, line feed and carriage return
+static inline int json_is_whitespace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline int json_hex_value(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+static inline void skip_whitespace(const char** cursor)
+{
+	while (json_is_whitespace(**cursor)) ++(*cursor);
+}
+
+// Skip whitespace and then character, returns 0 if it isn't there
+static inline int read_char(const char** cursor, char character)
+{
+	skip_whitespace(cursor);
+	int success = **cursor == character;
+	if (success) ++(*cursor);
+	return success;
+}
+
+// Step over literal if the input starts with it
+static inline int read_literal(const char** cursor, const char* literal)
+{
+	size_t len = strlen(literal);
+	if (strncmp(*cursor, literal, len) != 0) return 0;
+	*cursor += len;
+	return 1;
+}
+
+// Finalizer of splitmix64, spreads every input bit over the whole result
+static inline uint64_t json_hash_mix(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ull;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebull;
+	x ^= x >> 31;
+	return x;
+}
+
+// Length of the number at the start of s following the JSON grammar, 0 if there is none
+size_t json_number_length(const char* s);
+
+// Write codepoint as UTF-8 to out, which needs room for 4 bytes, return the length
+size_t json_utf8_encode(unsigned codepoint, char* out);
+
+// Decode the string whose opening quote is just before *cursor and append it to out,
+// a vector of char, including a terminating NUL. Moves cursor past the closing quote,
+// returns 0 if the string is invalid
+int json_decode_string(const char** cursor, vector* out);
+
+#endif
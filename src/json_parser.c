@@ -0,0 +1,520 @@
+#include "json_parser.h"
+#include "json_internal.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum json_parser_state {
+	STATE_VALUE, // Expect any value
+	STATE_VALUE_OR_CLOSE, // Just after '[', expect a value or ']'
+	STATE_KEY_OR_CLOSE, // Just after '{', expect a key or '}'
+	STATE_KEY, // After ',' in an object, expect a key
+	STATE_COLON, // After a key, expect ':'
+	STATE_COMMA_OR_CLOSE, // After a value in a container
+	STATE_STRING,
+	STATE_ESCAPE, // After '\' inside a string
+	STATE_UNICODE, // Reading the hex digits of \u
+	STATE_NUMBER,
+	STATE_LITERAL,
+	STATE_END, // Top level value is complete, only whitespace may follow
+	STATE_ERROR
+};
+
+static int parser_status(const json_parser* parser)
+{
+	switch (parser->state) {
+		case STATE_END:
+			return JSON_PARSER_DONE;
+		case STATE_ERROR:
+			return JSON_PARSER_ERROR;
+		default:
+			return JSON_PARSER_NEED_MORE;
+	}
+}
+
+static json_value* parser_top(json_parser* parser)
+{
+	return vector_get_checked(&parser->stack, parser->stack.size - 1);
+}
+
+// Hand a finished value to the enclosing container, or make it the result
+static void parser_emit(json_parser* parser, json_value* value)
+{
+	json_value* top = parser_top(parser);
+	if (top == NULL) {
+		parser->root = *value;
+		parser->state = STATE_END;
+		return;
+	}
+
+	vector_push_back(&top->value.array, value);
+	if (top->type == JSON_TYPE_OBJECT && top->value.object.size % 2 == 1) {
+		parser->state = STATE_COLON;
+	}
+	else {
+		parser->state = STATE_COMMA_OR_CLOSE;
+	}
+}
+
+static void parser_open(json_parser* parser, int type)
+{
+	if (parser->stack.size >= JSON_MAX_DEPTH) {
+		// Same limit as json_parse so both accept the same documents
+		parser->state = STATE_ERROR;
+		return;
+	}
+	json_value container = { .type = type };
+	vector_init(&container.value.array, sizeof(json_value));
+	vector_push_back(&parser->stack, &container);
+	parser->state = (type == JSON_TYPE_OBJECT) ? STATE_KEY_OR_CLOSE : STATE_VALUE_OR_CLOSE;
+}
+
+static void parser_close(json_parser* parser, int type)
+{
+	json_value* top = parser_top(parser);
+	if (top == NULL || top->type != type) {
+		parser->state = STATE_ERROR;
+		return;
+	}
+
+	json_value container;
+	vector_pop_back(&parser->stack, &container);
+	parser_emit(parser, &container);
+}
+
+static void parser_finish_string(json_parser* parser)
+{
+	size_t len = parser->token.size;
+	char* new_string = malloc(len + 1);
+	if (!new_string) {
+		parser->state = STATE_ERROR;
+		return;
+	}
+	memcpy(new_string, parser->token.data, len);
+	new_string[len] = '\0';
+
+	json_value value = { .type = JSON_TYPE_STRING };
+	value.value.string = new_string;
+	parser_emit(parser, &value);
+}
+
+static void parser_finish_number(json_parser* parser)
+{
+	size_t len = parser->token.size;
+	char terminator = '\0';
+	vector_push_back(&parser->token, &terminator);
+
+	if (len == 0 || json_number_length(parser->token.data) != len) {
+		parser->state = STATE_ERROR;
+		return;
+	}
+
+	json_value value = { .type = JSON_TYPE_NUMBER };
+	value.value.number = strtod(parser->token.data, NULL);
+	parser_emit(parser, &value);
+}
+
+// All four hex digits of a \u escape have been read
+static void parser_finish_codepoint(json_parser* parser)
+{
+	unsigned codepoint = parser->codepoint;
+	parser->state = STATE_STRING;
+
+	if (parser->high_surrogate) {
+		if (codepoint < 0xDC00 || codepoint > 0xDFFF) {
+			parser->state = STATE_ERROR;
+			return;
+		}
+		codepoint = 0x10000 + ((parser->high_surrogate - 0xD800) << 10) + (codepoint - 0xDC00);
+		parser->high_surrogate = 0;
+	}
+	else if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+		// Needs to be followed by the low half
+		parser->high_surrogate = codepoint;
+		return;
+	}
+	else if ((codepoint >= 0xDC00 && codepoint <= 0xDFFF) || codepoint == 0) {
+		// Lone low surrogate, or \u0000 which json_parse rejects as well
+		parser->state = STATE_ERROR;
+		return;
+	}
+	char buffer[4];
+	vector_append(&parser->token, buffer, json_utf8_encode(codepoint, buffer));
+}
+
+static void parser_escape(json_parser* parser, char c)
+{
+	char decoded;
+	if (parser->high_surrogate && c != 'u') {
+		parser->state = STATE_ERROR;
+		return;
+	}
+
+	switch (c) {
+		case '"':
+		case '\\':
+		case '/':
+			decoded = c;
+			break;
+		case 'b':
+			decoded = '\b';
+			break;
+		case 'f':
+			decoded = '\f';
+			break;
+		case 'n':
+			decoded = '\n';
+			break;
+		case 'r':
+			decoded = '\r';
+			break;
+		case 't':
+			decoded = '\t';
+			break;
+		case 'u':
+			parser->codepoint = 0;
+			parser->hex_digits = 0;
+			parser->state = STATE_UNICODE;
+			return;
+		default:
+			parser->state = STATE_ERROR;
+			return;
+	}
+	vector_push_back(&parser->token, &decoded);
+	parser->state = STATE_STRING;
+}
+
+static void parser_begin_value(json_parser* parser, char c)
+{
+	switch (c) {
+		case '"':
+			parser->token.size = 0;
+			parser->state = STATE_STRING;
+			break;
+		case '{':
+			parser_open(parser, JSON_TYPE_OBJECT);
+			break;
+		case '[':
+			parser_open(parser, JSON_TYPE_ARRAY);
+			break;
+		case 't':
+			parser->literal = "true";
+			parser->literal_pos = 1;
+			parser->state = STATE_LITERAL;
+			break;
+		case 'f':
+			parser->literal = "false";
+			parser->literal_pos = 1;
+			parser->state = STATE_LITERAL;
+			break;
+		case 'n':
+			parser->literal = "null";
+			parser->literal_pos = 1;
+			parser->state = STATE_LITERAL;
+			break;
+		default:
+			if (c == '-' || isdigit((unsigned char)c)) {
+				parser->token.size = 0;
+				vector_push_back(&parser->token, &c);
+				parser->state = STATE_NUMBER;
+			}
+			else {
+				parser->state = STATE_ERROR;
+			}
+			break;
+	}
+}
+
+static void parser_finish_literal(json_parser* parser)
+{
+	json_value value = { .type = JSON_TYPE_NULL };
+	if (parser->literal[0] != 'n') {
+		value.type = JSON_TYPE_BOOL;
+		value.value.boolean = parser->literal[0] == 't';
+	}
+	parser_emit(parser, &value);
+}
+
+// Consume a run of ordinary string characters in one go, returns the new position
+static const char* parser_string_run(json_parser* parser, const char* cursor, const char* end)
+{
+	const char* start = cursor;
+	while (cursor != end && *cursor != '"' && *cursor != '\\') {
+		if ((unsigned char)*cursor < 0x20) {
+			parser->state = STATE_ERROR;
+			return cursor;
+		}
+		++cursor;
+	}
+	if (cursor != start) {
+		if (parser->high_surrogate) {
+			parser->state = STATE_ERROR;
+			return cursor;
+		}
+		vector_append(&parser->token, start, cursor - start);
+	}
+	return cursor;
+}
+
+void json_parser_init(json_parser* parser)
+{
+	memset(parser, 0, sizeof(json_parser));
+	parser->state = STATE_VALUE;
+	parser->root.type = JSON_TYPE_NULL;
+	vector_init(&parser->stack, sizeof(json_value));
+	vector_init(&parser->token, sizeof(char));
+}
+
+int json_parser_feed(json_parser* parser, const char* bytes, size_t n)
+{
+	if (n == 0) {
+		// End of input, a top level number is only complete now
+		if (parser->state == STATE_NUMBER && parser->stack.size == 0) {
+			parser_finish_number(parser);
+		}
+		else if (parser->state != STATE_END) {
+			parser->state = STATE_ERROR;
+		}
+		return parser_status(parser);
+	}
+
+	const char* cursor = bytes;
+	const char* end = bytes + n;
+
+	while (cursor != end && parser->state != STATE_ERROR) {
+		char c = *cursor;
+		switch (parser->state) {
+			case STATE_VALUE:
+			case STATE_VALUE_OR_CLOSE:
+			case STATE_KEY_OR_CLOSE:
+			case STATE_KEY:
+			case STATE_COLON:
+			case STATE_COMMA_OR_CLOSE:
+			case STATE_END:
+				++cursor;
+				if (json_is_whitespace(c)) break;
+
+				if (parser->state == STATE_VALUE) {
+					parser_begin_value(parser, c);
+				}
+				else if (parser->state == STATE_VALUE_OR_CLOSE) {
+					if (c == ']') parser_close(parser, JSON_TYPE_ARRAY);
+					else parser_begin_value(parser, c);
+				}
+				else if (parser->state == STATE_KEY_OR_CLOSE && c == '}') {
+					parser_close(parser, JSON_TYPE_OBJECT);
+				}
+				else if (parser->state == STATE_KEY_OR_CLOSE || parser->state == STATE_KEY) {
+					parser->token.size = 0;
+					parser->state = (c == '"') ? STATE_STRING : STATE_ERROR;
+				}
+				else if (parser->state == STATE_COLON) {
+					parser->state = (c == ':') ? STATE_VALUE : STATE_ERROR;
+				}
+				else if (parser->state == STATE_COMMA_OR_CLOSE) {
+					if (c == ',') {
+						parser->state = (parser_top(parser)->type == JSON_TYPE_OBJECT) ? STATE_KEY : STATE_VALUE;
+					}
+					else if (c == ']') parser_close(parser, JSON_TYPE_ARRAY);
+					else if (c == '}') parser_close(parser, JSON_TYPE_OBJECT);
+					else parser->state = STATE_ERROR;
+				}
+				else {
+					// Garbage after the end of the value
+					parser->state = STATE_ERROR;
+				}
+				break;
+			case STATE_STRING:
+				cursor = parser_string_run(parser, cursor, end);
+				if (cursor == end || parser->state == STATE_ERROR) break;
+				if (*cursor == '"') {
+					if (parser->high_surrogate) parser->state = STATE_ERROR;
+					else parser_finish_string(parser);
+				}
+				else {
+					parser->state = STATE_ESCAPE;
+				}
+				++cursor;
+				break;
+			case STATE_ESCAPE:
+				parser_escape(parser, c);
+				++cursor;
+				break;
+			case STATE_UNICODE: {
+				int digit = json_hex_value(c);
+				if (digit < 0) {
+					parser->state = STATE_ERROR;
+					break;
+				}
+				parser->codepoint = (parser->codepoint << 4) | (unsigned)digit;
+				if (++parser->hex_digits == 4) parser_finish_codepoint(parser);
+				++cursor;
+				break;
+			}
+			case STATE_NUMBER:
+				if (c != '\0' && strchr("0123456789+-.eE", c)) {
+					vector_push_back(&parser->token, &c);
+					++cursor;
+				}
+				else {
+					// Don't consume, the character belongs to the enclosing container
+					parser_finish_number(parser);
+				}
+				break;
+			case STATE_LITERAL:
+				if (c != parser->literal[parser->literal_pos]) {
+					parser->state = STATE_ERROR;
+					break;
+				}
+				++cursor;
+				if (parser->literal[++parser->literal_pos] == '\0') parser_finish_literal(parser);
+				break;
+		}
+	}
+
+	return parser_status(parser);
+}
+
+int json_parser_result(json_parser* parser, json_value* result)
+{
+	if (parser->state != STATE_END) return 0;
+	*result = parser->root;
+	parser->root.type = JSON_TYPE_NULL;
+	return 1;
+}
+
+void json_parser_free(json_parser* parser)
+{
+	if (!parser) return;
+	vector_foreach(&parser->stack, (void(*)(void*))json_free_value);
+	vector_free(&parser->stack);
+	vector_free(&parser->token);
+	json_free_value(&parser->root);
+}
+
+#ifdef BUILD_TEST
+
+#include <stdio.h>
+
+// Feed input in chunks of chunk bytes followed by the end marker
+static int feed_chunked(const char* input, size_t chunk, json_value* result)
+{
+	json_parser parser;
+	json_parser_init(&parser);
+	size_t len = strlen(input);
+	int status = JSON_PARSER_NEED_MORE;
+	for (size_t i = 0; i < len && status != JSON_PARSER_ERROR; i += chunk) {
+		size_t n = (len - i < chunk) ? len - i : chunk;
+		status = json_parser_feed(&parser, input + i, n);
+	}
+	status = json_parser_feed(&parser, NULL, 0);
+	int success = json_parser_result(&parser, result);
+	assert(success == (status == JSON_PARSER_DONE));
+	json_parser_free(&parser);
+	return success;
+}
+
+void json_parser_test_chunks(void)
+{
+	printf("json_parser_test_chunks: ");
+	const char* string = " { \"item1\" : [1, 2.5, -3e2, true], \"item2\" : { \"a\" : null, \"b\" : \"x\\\"y\" }, \"\" : [] }";
+	for (size_t chunk = 1; chunk < 8; ++chunk) {
+		json_value root = { .type = JSON_TYPE_NULL };
+		assert(feed_chunked(string, chunk, &root));
+		assert(root.type == JSON_TYPE_OBJECT);
+		assert(root.value.object.size == 6);
+
+		json_value* val = json_value_with_key(&root, "item1");
+		assert(val != NULL && val->type == JSON_TYPE_ARRAY);
+		assert(val->value.array.size == 4);
+		json_value* items = (json_value*)val->value.array.data;
+		assert(json_value_to_double(&items[1]) == 2.5);
+		assert(json_value_to_double(&items[2]) == -300.0);
+		assert(json_value_to_bool(&items[3]));
+
+		val = json_value_with_key(&root, "item2");
+		assert(val != NULL && val->type == JSON_TYPE_OBJECT);
+		assert(json_value_with_key(val, "a")->type == JSON_TYPE_NULL);
+		assert(strcmp(json_value_to_string(json_value_with_key(val, "b")), "x\"y") == 0);
+		json_free_value(&root);
+	}
+	printf(" OK\n");
+}
+
+void json_parser_test_status(void)
+{
+	printf("json_parser_test_status: ");
+	{
+		// Containers are done as soon as they close
+		json_parser parser;
+		json_parser_init(&parser);
+		assert(json_parser_feed(&parser, "[1, ", 4) == JSON_PARSER_NEED_MORE);
+		assert(json_parser_feed(&parser, "2]", 2) == JSON_PARSER_DONE);
+		assert(json_parser_feed(&parser, "  \n", 3) == JSON_PARSER_DONE);
+		assert(json_parser_feed(&parser, "x", 1) == JSON_PARSER_ERROR);
+		assert(json_parser_feed(&parser, "]", 1) == JSON_PARSER_ERROR);
+		json_parser_free(&parser);
+	}
+	{
+		// A top level number needs the end of the input
+		json_parser parser;
+		json_parser_init(&parser);
+		assert(json_parser_feed(&parser, "12", 2) == JSON_PARSER_NEED_MORE);
+		assert(json_parser_feed(&parser, "3", 1) == JSON_PARSER_NEED_MORE);
+		assert(json_parser_feed(&parser, NULL, 0) == JSON_PARSER_DONE);
+		json_value result;
+		assert(json_parser_result(&parser, &result));
+		assert(json_value_to_double(&result) == 123.0);
+		json_parser_free(&parser);
+	}
+	{
+		// Truncated input, the partial tree is released by json_parser_free
+		json_parser parser;
+		json_parser_init(&parser);
+		assert(json_parser_feed(&parser, "{\"a\": [\"b\", {\"c\"", 16) == JSON_PARSER_NEED_MORE);
+		assert(json_parser_feed(&parser, NULL, 0) == JSON_PARSER_ERROR);
+		json_value result;
+		assert(!json_parser_result(&parser, &result));
+		json_parser_free(&parser);
+	}
+	printf(" OK\n");
+}
+
+void json_parser_test_invalid(void)
+{
+	printf("json_parser_test_invalid: ");
+	const char* invalid[] = {
+		"", "[0, 2,,]", "[0, 2, 0", "{\"a\" 1}", "{1 : 2}", "[1}", "{\"a\":1]",
+		"nulltrue", "tru", "\"abc", "\"\\x\"", "\"\\u0000\"", "\"\\ud800\"", "1.2.3", "--1", "[1 2]"
+	};
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+		for (size_t chunk = 1; chunk < 4; ++chunk) {
+			json_value result = { .type = JSON_TYPE_NULL };
+			assert(!feed_chunked(invalid[i], chunk, &result));
+			assert(result.type == JSON_TYPE_NULL);
+		}
+	}
+	printf(" OK\n");
+}
+
+void json_parser_test_unicode(void)
+{
+	printf("json_parser_test_unicode: ");
+	json_value result = { .type = JSON_TYPE_NULL };
+	assert(feed_chunked("\"a\\u0041\\u00e9\\u20ac\\ud83d\\ude00\\n\"", 1, &result));
+	assert(strcmp(json_value_to_string(&result), "aA\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\n") == 0);
+	json_free_value(&result);
+	printf(" OK\n");
+}
+
+void json_parser_test_all(void)
+{
+	json_parser_test_chunks();
+	json_parser_test_status();
+	json_parser_test_invalid();
+	json_parser_test_unicode();
+}
+
+#endif
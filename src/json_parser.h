@@ -0,0 +1,53 @@
+#ifndef HS_JSON_PARSER_H
+#define HS_JSON_PARSER_H
+
+#include "json.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Incremental parser, input can be handed over in arbitrary chunks e.g. as
+// they arrive from the network. The partially built tree and the string or
+// number in progress are kept between calls.
+
+enum json_parser_status {
+	JSON_PARSER_NEED_MORE,
+	JSON_PARSER_DONE,
+	JSON_PARSER_ERROR
+};
+
+typedef struct {
+	int state;
+	vector stack; // Open containers, innermost last
+	vector token; // Characters of the string or number in progress
+	const char* literal; // Literal being matched and how far we got
+	size_t literal_pos;
+	unsigned codepoint; // \u escape in progress
+	unsigned high_surrogate;
+	int hex_digits;
+	json_value root;
+} json_parser;
+
+void json_parser_init(json_parser* parser);
+
+// Parse the next n bytes, pass n == 0 to signal the end of the input.
+// Returns one of json_parser_status. A top level number can only be finished
+// at the end of the input, all other values are DONE as soon as they close
+int json_parser_feed(json_parser* parser, const char* bytes, size_t n);
+
+// Move the parsed value into result, return 1 if the parser was done
+int json_parser_result(json_parser* parser, json_value* result);
+
+// Free the parser and any partial or unclaimed result
+void json_parser_free(json_parser* parser);
+
+#ifdef BUILD_TEST
+void json_parser_test_all(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
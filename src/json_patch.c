@@ -0,0 +1,1094 @@
+#include "json_patch.h"
+#include "json_internal.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Decode the reference token at cursor up to the next '/' into token, NUL terminated.
+// Returns 0 for a '~' that isn't followed by '0' or '1'
+static int json_pointer_token(const char** cursor, const char* end, vector* token)
+{
+	token->size = 0;
+	const char* c = *cursor;
+	while (c < end && *c != '/') {
+		char character = *c++;
+		if (character == '~') {
+			if (c == end || (*c != '0' && *c != '1')) return 0;
+			character = *c++ == '0' ? '~' : '/';
+		}
+		vector_push_back(token, &character);
+	}
+	vector_push_back(token, "");
+	*cursor = c;
+	return 1;
+}
+
+// Array index without sign or leading zeros
+static int json_pointer_index(const char* token, size_t* index)
+{
+	if (!*token || (token[0] == '0' && token[1])) return 0;
+	size_t value = 0;
+	for (; *token; ++token) {
+		if (*token < '0' || *token > '9') return 0;
+		if (value > (SIZE_MAX - 9) / 10) return 0;
+		value = value * 10 + (size_t)(*token - '0');
+	}
+	*index = value;
+	return 1;
+}
+
+// Member number of key in object, the number of members if it is missing
+static size_t json_member_position(const json_value* object, const char* key)
+{
+	const json_value* items = (const json_value*)object->value.object.data;
+	size_t count = object->value.object.size / 2;
+	size_t position = 0;
+	while (position < count && strcmp(items[position * 2].value.key, key) != 0) ++position;
+	return position;
+}
+
+static json_value* json_pointer_child(json_value* parent, const char* token)
+{
+	if (parent->type == JSON_TYPE_OBJECT) return json_value_with_key(parent, token);
+	size_t index;
+	if (parent->type != JSON_TYPE_ARRAY || !json_pointer_index(token, &index)) return NULL;
+	return index < parent->value.array.size ? (json_value*)parent->value.array.data + index : NULL;
+}
+
+// Resolve the first length characters of pointer
+static json_value* json_pointer_find(json_value* root, const char* pointer, size_t length, vector* token)
+{
+	const char* cursor = pointer;
+	const char* end = pointer + length;
+	while (root && cursor < end) {
+		if (*cursor++ != '/' || !json_pointer_token(&cursor, end, token)) return NULL;
+		root = json_pointer_child(root, token->data);
+	}
+	return root;
+}
+
+json_value* json_pointer_get(json_value* root, const char* pointer)
+{
+	vector token;
+	vector_init(&token, sizeof(char));
+	json_value* result = json_pointer_find(root, pointer, strlen(pointer), &token);
+	vector_free(&token);
+	return result;
+}
+
+static void json_value_take(json_value* dst, json_value* src)
+{
+	*dst = *src;
+	src->type = JSON_TYPE_NULL;
+	src->flags = 0;
+}
+
+// Members are about to be added or removed, a key index left by json_freeze or the
+// order of sorted keys would be stale
+static vector* json_members_for_update(json_value* container)
+{
+	container->flags &= ~(unsigned)(JSON_FLAG_KEY_INDEX | JSON_FLAG_SORTED_KEYS);
+	return &container->value.array;
+}
+
+// Merging an object into a non object drops its null members at every level of objects
+static void json_merge_strip_nulls(json_value* object)
+{
+	json_value* items = (json_value*)object->value.object.data;
+	size_t i = 0;
+	while (i < object->value.object.size) {
+		if (items[i + 1].type == JSON_TYPE_NULL) {
+			json_free_value(&items[i]);
+			vector_erase(json_members_for_update(object), i, 2);
+			continue;
+		}
+		if (items[i + 1].type == JSON_TYPE_OBJECT) json_merge_strip_nulls(&items[i + 1]);
+		i += 2;
+	}
+}
+
+void json_merge_patch(json_value* target, json_value* patch)
+{
+	assert(!(target->flags & JSON_FLAG_FROZEN));
+	if (patch->type != JSON_TYPE_OBJECT || target->type != JSON_TYPE_OBJECT) {
+		json_free_value(target);
+		json_value_take(target, patch);
+		if (target->type == JSON_TYPE_OBJECT) json_merge_strip_nulls(target);
+		return;
+	}
+
+	json_value* members = (json_value*)patch->value.object.data;
+	for (size_t i = 0; i < patch->value.object.size; i += 2) {
+		json_value* key = &members[i];
+		json_value* value = &members[i + 1];
+		size_t position = json_member_position(target, key->value.key);
+		int found = position < target->value.object.size / 2;
+		json_value* items = (json_value*)target->value.object.data;
+		if (value->type == JSON_TYPE_NULL) {
+			if (!found) continue;
+			json_free_value(&items[position * 2]);
+			json_free_value(&items[position * 2 + 1]);
+			vector_erase(json_members_for_update(target), position * 2, 2);
+		}
+		else if (found) {
+			json_merge_patch(&items[position * 2 + 1], value);
+		}
+		else {
+			json_value pair[2] = { { .type = JSON_TYPE_NULL }, { .type = JSON_TYPE_NULL } };
+			json_value_take(&pair[0], key);
+			json_merge_patch(&pair[1], value);
+			vector_append(json_members_for_update(target), pair, 2);
+		}
+	}
+	json_free_value(patch);
+}
+
+// Changes made by json_patch_apply, undone in reverse order if an operation fails.
+// Containers are found again by their pointer as earlier changes may have moved them
+enum {
+	JSON_UNDO_ERASE, // Remove what was inserted at position
+	JSON_UNDO_INSERT, // Put key and value back at position
+	JSON_UNDO_SWAP // Put value back at path
+};
+
+typedef struct {
+	int kind;
+	const char* path; // Container for ERASE and INSERT, the value itself for SWAP
+	size_t length;
+	size_t position; // Counted in members for objects
+	int carry; // INSERT of a moved value, it's taken out again by the entry undone before this one
+	json_value key;
+	json_value value;
+} json_patch_undo;
+
+typedef struct {
+	json_value* root;
+	vector undo;
+	vector token;
+} json_patch_state;
+
+static void json_patch_log(json_patch_state* state, int kind, const char* path, size_t length, size_t position)
+{
+	json_patch_undo undo = { .kind = kind, .path = path, .length = length, .position = position };
+	undo.key.type = JSON_TYPE_NULL;
+	undo.value.type = JSON_TYPE_NULL;
+	vector_push_back(&state->undo, &undo);
+}
+
+static void json_container_insert(json_value* container, size_t position, json_value* key, json_value* value)
+{
+	if (container->type == JSON_TYPE_OBJECT) {
+		json_value pair[2] = { *key, *value };
+		vector_insert(json_members_for_update(container), position * 2, pair, 2);
+	}
+	else {
+		vector_insert(&container->value.array, position, value, 1);
+	}
+}
+
+static void json_container_erase(json_value* container, size_t position, json_value* key, json_value* value)
+{
+	json_value* items = (json_value*)container->value.array.data;
+	if (container->type == JSON_TYPE_OBJECT) {
+		*key = items[position * 2];
+		*value = items[position * 2 + 1];
+		vector_erase(json_members_for_update(container), position * 2, 2);
+	}
+	else {
+		*value = items[position];
+		vector_erase(&container->value.array, position, 1);
+	}
+}
+
+static void json_patch_rollback(json_patch_state* state)
+{
+	json_value carry = { .type = JSON_TYPE_NULL };
+	for (size_t i = state->undo.size; i-- > 0;) {
+		json_patch_undo* undo = vector_get(&state->undo, i);
+		json_value* target = json_pointer_find(state->root, undo->path, undo->length, &state->token);
+		assert(target != NULL);
+		json_value key = { .type = JSON_TYPE_NULL };
+		json_value taken = { .type = JSON_TYPE_NULL };
+		switch (undo->kind) {
+			case JSON_UNDO_ERASE:
+				json_container_erase(target, undo->position, &key, &taken);
+				json_free_value(&key);
+				break;
+			case JSON_UNDO_INSERT:
+				json_container_insert(target, undo->position, &undo->key, undo->carry ? &carry : &undo->value);
+				break;
+			case JSON_UNDO_SWAP:
+				taken = *target;
+				*target = undo->value;
+				break;
+		}
+		json_patch_undo* next = i > 0 ? vector_get(&state->undo, i - 1) : NULL;
+		if (next && next->kind == JSON_UNDO_INSERT && next->carry) carry = taken;
+		else json_free_value(&taken);
+	}
+	state->undo.size = 0;
+}
+
+// Free what the changes replaced or removed once the whole patch succeeded
+static void json_patch_commit(json_patch_state* state)
+{
+	for (size_t i = 0; i < state->undo.size; ++i) {
+		json_patch_undo* undo = vector_get(&state->undo, i);
+		json_free_value(&undo->key);
+		if (!undo->carry) json_free_value(&undo->value);
+	}
+	state->undo.size = 0;
+}
+
+// Container holding the value at path, the last token is left in state->token
+static json_value* json_patch_parent(json_patch_state* state, const char* path, size_t* parent_length)
+{
+	const char* slash = strrchr(path, '/');
+	if (!slash) return NULL;
+	*parent_length = (size_t)(slash - path);
+	json_value* parent = json_pointer_find(state->root, path, *parent_length, &state->token);
+	const char* cursor = slash + 1;
+	if (!parent || !json_pointer_token(&cursor, path + strlen(path), &state->token)) return NULL;
+	return parent;
+}
+
+// Takes over value on success
+static int json_patch_add(json_patch_state* state, const char* path, json_value* value)
+{
+	size_t parent_length;
+	if (*path == '\0') {
+		json_patch_log(state, JSON_UNDO_SWAP, path, 0, 0);
+		json_patch_undo* undo = vector_get(&state->undo, state->undo.size - 1);
+		json_value_take(&undo->value, state->root);
+		json_value_take(state->root, value);
+		return 1;
+	}
+	json_value* parent = json_patch_parent(state, path, &parent_length);
+	if (!parent) return 0;
+	const char* token = state->token.data;
+
+	if (parent->type == JSON_TYPE_OBJECT) {
+		size_t position = json_member_position(parent, token);
+		if (position < parent->value.object.size / 2) {
+			json_patch_log(state, JSON_UNDO_SWAP, path, strlen(path), 0);
+			json_patch_undo* undo = vector_get(&state->undo, state->undo.size - 1);
+			json_value* slot = (json_value*)parent->value.object.data + position * 2 + 1;
+			json_value_take(&undo->value, slot);
+			json_value_take(slot, value);
+			return 1;
+		}
+		size_t size = state->token.size;
+		json_value key = { .type = JSON_TYPE_STRING };
+		key.value.key = malloc(size);
+		if (!key.value.key) abort();
+		memcpy(key.value.key, token, size);
+		json_container_insert(parent, position, &key, value);
+		json_patch_log(state, JSON_UNDO_ERASE, path, parent_length, position);
+	}
+	else if (parent->type == JSON_TYPE_ARRAY) {
+		size_t position = parent->value.array.size;
+		if (strcmp(token, "-") != 0 && (!json_pointer_index(token, &position) || position > parent->value.array.size)) return 0;
+		json_container_insert(parent, position, NULL, value);
+		json_patch_log(state, JSON_UNDO_ERASE, path, parent_length, position);
+	}
+	else {
+		return 0;
+	}
+	value->type = JSON_TYPE_NULL;
+	value->flags = 0;
+	return 1;
+}
+
+// The removed value is kept for a rollback, or handed to moved
+static int json_patch_remove(json_patch_state* state, const char* path, json_value* moved)
+{
+	size_t parent_length;
+	json_value* parent = json_patch_parent(state, path, &parent_length);
+	if (!parent) return 0;
+	const char* token = state->token.data;
+
+	size_t position;
+	if (parent->type == JSON_TYPE_OBJECT) {
+		position = json_member_position(parent, token);
+		if (position == parent->value.object.size / 2) return 0;
+	}
+	else if (parent->type == JSON_TYPE_ARRAY) {
+		if (!json_pointer_index(token, &position) || position >= parent->value.array.size) return 0;
+	}
+	else {
+		return 0;
+	}
+
+	json_patch_log(state, JSON_UNDO_INSERT, path, parent_length, position);
+	json_patch_undo* undo = vector_get(&state->undo, state->undo.size - 1);
+	json_container_erase(parent, position, &undo->key, moved ? moved : &undo->value);
+	undo->carry = moved != NULL;
+	return 1;
+}
+
+static int json_patch_move(json_patch_state* state, const char* from, const char* path)
+{
+	size_t length = strlen(from);
+	if (strcmp(from, path) == 0) return json_pointer_find(state->root, from, length, &state->token) != NULL;
+	// A value can't be moved into one of its own children
+	if (strncmp(from, path, length) == 0 && path[length] == '/') return 0;
+
+	json_value value;
+	if (!json_patch_remove(state, from, &value)) return 0;
+	size_t removed = state->undo.size - 1;
+	if (json_patch_add(state, path, &value)) return 1;
+
+	// Nothing took the value, the rollback puts it back itself
+	json_patch_undo* undo = vector_get(&state->undo, removed);
+	undo->carry = 0;
+	undo->value = value;
+	return 0;
+}
+
+static int json_patch_operation(json_patch_state* state, json_value* operation)
+{
+	const char* op;
+	const char* path;
+	const char* from = NULL;
+	if (operation->type != JSON_TYPE_OBJECT) return 0;
+	if (!json_get_string(json_value_with_key(operation, "op"), &op)) return 0;
+	if (!json_get_string(json_value_with_key(operation, "path"), &path)) return 0;
+	json_value* value = json_value_with_key(operation, "value");
+	json_get_string(json_value_with_key(operation, "from"), &from);
+
+	if (strcmp(op, "add") == 0) {
+		return value && json_patch_add(state, path, value);
+	}
+	if (strcmp(op, "remove") == 0) {
+		return json_patch_remove(state, path, NULL);
+	}
+	if (strcmp(op, "replace") == 0) {
+		json_value* slot = json_pointer_find(state->root, path, strlen(path), &state->token);
+		if (!value || !slot) return 0;
+		json_patch_log(state, JSON_UNDO_SWAP, path, strlen(path), 0);
+		json_patch_undo* undo = vector_get(&state->undo, state->undo.size - 1);
+		json_value_take(&undo->value, slot);
+		json_value_take(slot, value);
+		return 1;
+	}
+	if (strcmp(op, "move") == 0) {
+		return from && json_patch_move(state, from, path);
+	}
+	if (strcmp(op, "copy") == 0) {
+		json_value* source = from ? json_pointer_find(state->root, from, strlen(from), &state->token) : NULL;
+		if (!source) return 0;
+		json_value copy;
+		json_clone(&copy, source);
+		if (json_patch_add(state, path, &copy)) return 1;
+		json_free_value(&copy);
+		return 0;
+	}
+	if (strcmp(op, "test") == 0) {
+		json_value* actual = json_pointer_find(state->root, path, strlen(path), &state->token);
+		return value && actual && json_equal(actual, value);
+	}
+	return 0;
+}
+
+int json_patch_apply(json_value* target, json_value* ops)
+{
+	assert(!(target->flags & JSON_FLAG_FROZEN));
+	if (ops->type != JSON_TYPE_ARRAY) return 0;
+
+	json_patch_state state = { .root = target };
+	vector_init(&state.undo, sizeof(json_patch_undo));
+	vector_init(&state.token, sizeof(char));
+
+	int success = 1;
+	json_value* operations = (json_value*)ops->value.array.data;
+	for (size_t i = 0; i < ops->value.array.size && success; ++i) {
+		success = json_patch_operation(&state, &operations[i]);
+	}
+	if (success) json_patch_commit(&state);
+	else json_patch_rollback(&state);
+
+	vector_free(&state.undo);
+	vector_free(&state.token);
+	return success;
+}
+
+// Arrays that take at most this many insertions and deletions to align are aligned on
+// their longest common subsequence, others position by position. Aligning costs
+// O((N + M) * edits) time and O(edits^2) memory
+#ifndef JSON_DIFF_MAX_EDITS
+#define JSON_DIFF_MAX_EDITS 1024
+#endif
+
+// Summary of a subtree, kept in pre-order with object keys counting as nodes
+typedef struct {
+	uint64_t hash;
+	size_t count; // Nodes in the subtree
+} json_diff_node;
+
+typedef struct {
+	vector a_nodes;
+	vector b_nodes;
+	vector path; // char, JSON Pointer of the values being compared, not terminated
+	json_value* patch;
+} json_diff_state;
+
+enum {
+	JSON_DIFF_KEEP,
+	JSON_DIFF_PAIR, // Diff a[i] against b[j]
+	JSON_DIFF_DELETE,
+	JSON_DIFF_INSERT
+};
+
+typedef struct {
+	int kind;
+	size_t i;
+	size_t j;
+} json_diff_edit;
+
+// Hash every subtree once, objects by the sum of their members like json_hash
+static uint64_t json_diff_summarize(const json_value* value, vector* nodes)
+{
+	size_t index = nodes->size;
+	json_diff_node node = { 0, 1 };
+	vector_push_back(nodes, &node);
+
+	uint64_t hash = json_hash_mix((uint64_t)value->type << 56 ^ value->value.array.size);
+	const json_value* items = (const json_value*)value->value.array.data;
+	if (value->type == JSON_TYPE_ARRAY) {
+		for (size_t i = 0; i < value->value.array.size; ++i) {
+			hash = json_hash_mix(hash + json_diff_summarize(&items[i], nodes));
+		}
+	}
+	else if (value->type == JSON_TYPE_OBJECT) {
+		for (size_t i = 0; i < value->value.object.size; i += 2) {
+			uint64_t key = json_diff_summarize(&items[i], nodes);
+			hash += json_hash_mix(key ^ json_hash_mix(json_diff_summarize(&items[i + 1], nodes)));
+		}
+	}
+	else {
+		hash = json_hash(value);
+	}
+
+	json_diff_node* summary = vector_get(nodes, index);
+	summary->hash = hash;
+	summary->count = nodes->size - index;
+	return hash;
+}
+
+static const json_diff_node* json_diff_node_at(const vector* nodes, size_t index)
+{
+	return (const json_diff_node*)vector_get(nodes, index);
+}
+
+static int json_diff_same(json_diff_state* state, const json_value* a, size_t ai, const json_value* b, size_t bi)
+{
+	return json_diff_node_at(&state->a_nodes, ai)->hash == json_diff_node_at(&state->b_nodes, bi)->hash
+		&& json_equal(a, b);
+}
+
+// Pre-order index of every element, or of every member's value for objects
+static size_t* json_diff_children(const json_value* value, size_t index, const vector* nodes)
+{
+	size_t stride = value->type == JSON_TYPE_OBJECT ? 2 : 1;
+	size_t count = value->value.array.size / stride;
+	size_t* children = malloc((count + 1) * sizeof(size_t));
+	if (!children) abort();
+	index += 1;
+	for (size_t i = 0; i < count; ++i) {
+		if (stride == 2) index += 1; // The key
+		children[i] = index;
+		index += json_diff_node_at(nodes, index)->count;
+	}
+	return children;
+}
+
+static size_t json_diff_path_push_key(json_diff_state* state, const char* key)
+{
+	size_t length = state->path.size;
+	vector_push_back(&state->path, "/");
+	for (; *key; ++key) {
+		if (*key == '~') vector_append(&state->path, "~0", 2);
+		else if (*key == '/') vector_append(&state->path, "~1", 2);
+		else vector_push_back(&state->path, (void*)key);
+	}
+	return length;
+}
+
+static size_t json_diff_path_push_index(json_diff_state* state, size_t index)
+{
+	size_t length = state->path.size;
+	char token[24];
+	int written = sprintf(token, "/%zu", index);
+	vector_append(&state->path, token, (size_t)written);
+	return length;
+}
+
+static json_value json_diff_string(const char* text, size_t length)
+{
+	json_value string = { .type = JSON_TYPE_STRING };
+	string.value.string = malloc(length + 1);
+	if (!string.value.string) abort();
+	memcpy(string.value.string, text, length);
+	string.value.string[length] = '\0';
+	return string;
+}
+
+// Append an operation on the current path, value is copied
+static void json_diff_emit(json_diff_state* state, const char* op, const json_value* value)
+{
+	json_value operation = { .type = JSON_TYPE_OBJECT };
+	vector_init(&operation.value.object, sizeof(json_value));
+	json_value member[6] = {
+		json_diff_string("op", 2), json_diff_string(op, strlen(op)),
+		json_diff_string("path", 4), json_diff_string(state->path.data, state->path.size)
+	};
+	size_t count = 4;
+	if (value) {
+		member[4] = json_diff_string("value", 5);
+		json_clone(&member[5], value);
+		count = 6;
+	}
+	vector_append(&operation.value.object, member, count);
+	vector_push_back(&state->patch->value.array, &operation);
+}
+
+static void json_diff_value(json_diff_state* state, const json_value* a, size_t ai, const json_value* b, size_t bi);
+
+static void json_diff_object(json_diff_state* state, const json_value* a, size_t ai, const json_value* b, size_t bi)
+{
+	const json_value* a_items = (const json_value*)a->value.object.data;
+	const json_value* b_items = (const json_value*)b->value.object.data;
+	size_t a_count = a->value.object.size / 2;
+	size_t b_count = b->value.object.size / 2;
+	size_t* a_children = json_diff_children(a, ai, &state->a_nodes);
+	size_t* b_children = json_diff_children(b, bi, &state->b_nodes);
+
+	// Open addressing table of b's keys, slots hold member number + 1. Only the first of
+	// duplicated keys goes in, that's the one a JSON Pointer reaches
+	size_t slots = 1;
+	while (slots < b_count * 2) slots *= 2;
+	size_t* table = calloc(slots, sizeof(size_t));
+	unsigned char* matched = calloc(b_count + 1, 1);
+	if (!table || !matched) abort();
+	for (size_t j = 0; j < b_count; ++j) {
+		const char* key = b_items[j * 2].value.key;
+		size_t slot = json_key_hash(key, strlen(key)) & (slots - 1);
+		while (table[slot] && strcmp(b_items[(table[slot] - 1) * 2].value.key, key) != 0) slot = (slot + 1) & (slots - 1);
+		if (!table[slot]) table[slot] = j + 1;
+		else matched[j] = 1; // Duplicate, never added
+	}
+
+	for (size_t i = 0; i < a_count; ++i) {
+		const char* key = a_items[i * 2].value.key;
+		size_t slot = json_key_hash(key, strlen(key)) & (slots - 1);
+		while (table[slot] && strcmp(b_items[(table[slot] - 1) * 2].value.key, key) != 0) slot = (slot + 1) & (slots - 1);
+		size_t path = json_diff_path_push_key(state, key);
+		if (!table[slot]) {
+			json_diff_emit(state, "remove", NULL);
+		}
+		else if (!matched[table[slot] - 1]) {
+			size_t j = table[slot] - 1;
+			matched[j] = 1;
+			json_diff_value(state, &a_items[i * 2 + 1], a_children[i], &b_items[j * 2 + 1], b_children[j]);
+		}
+		state->path.size = path;
+	}
+
+	for (size_t j = 0; j < b_count; ++j) {
+		if (matched[j]) continue;
+		size_t path = json_diff_path_push_key(state, b_items[j * 2].value.key);
+		json_diff_emit(state, "add", &b_items[j * 2 + 1]);
+		state->path.size = path;
+	}
+
+	free(table);
+	free(matched);
+	free(a_children);
+	free(b_children);
+}
+
+static int json_diff_hash_equal(json_diff_state* state, const size_t* a_children, size_t i, const size_t* b_children, size_t j)
+{
+	return json_diff_node_at(&state->a_nodes, a_children[i])->hash == json_diff_node_at(&state->b_nodes, b_children[j])->hash;
+}
+
+// Shortest edit script for the middle parts a[first, a_end) and b[first, b_end) with Myers'
+// algorithm, comparing subtree hashes. Returns 0 and leaves edits empty if that takes
+// more than JSON_DIFF_MAX_EDITS insertions and deletions
+static int json_diff_align(json_diff_state* state, const json_value* a, const size_t* a_children, size_t a_end,
+	const json_value* b, const size_t* b_children, size_t b_end, size_t first, vector* edits)
+{
+	size_t m = a_end - first;
+	size_t n = b_end - first;
+	size_t limit = m + n < JSON_DIFF_MAX_EDITS ? m + n : JSON_DIFF_MAX_EDITS;
+
+	// Furthest x reached on each diagonal k = x - y, at index k + limit + 1. Round d of the
+	// trace holds them for k in [-d, d] at offset d * d
+	size_t* furthest = calloc(2 * limit + 3, sizeof(size_t));
+	if (!furthest) abort();
+	size_t* diagonals = furthest + limit + 1;
+	vector trace;
+	vector_init(&trace, sizeof(size_t));
+	size_t d = 0;
+	for (; d <= limit; ++d) {
+		int done = 0;
+		for (ptrdiff_t k = -(ptrdiff_t)d; k <= (ptrdiff_t)d; k += 2) {
+			size_t x = (k == -(ptrdiff_t)d || (k != (ptrdiff_t)d && diagonals[k - 1] < diagonals[k + 1]))
+				? diagonals[k + 1] : diagonals[k - 1] + 1;
+			size_t y = (size_t)((ptrdiff_t)x - k);
+			while (x < m && y < n && json_diff_hash_equal(state, a_children, first + x, b_children, first + y)) {
+				++x;
+				++y;
+			}
+			diagonals[k] = x;
+			if (x >= m && y >= n) {
+				done = 1;
+				break;
+			}
+		}
+		if (done) break;
+		vector_append(&trace, diagonals - d, 2 * d + 1);
+	}
+	free(furthest);
+	if (d > limit) {
+		vector_free(&trace);
+		return 0;
+	}
+
+	// Walk back from the end, the script comes out reversed. Hash matches that aren't
+	// equal become a deletion and an insertion, which get paired up and diffed
+	const json_value* a_items = (const json_value*)a->value.array.data;
+	const json_value* b_items = (const json_value*)b->value.array.data;
+	size_t x = m;
+	size_t y = n;
+	for (;; --d) {
+		ptrdiff_t k = (ptrdiff_t)x - (ptrdiff_t)y;
+		size_t start_x = 0;
+		int inserted = 0;
+		if (d > 0) {
+			const size_t* previous = (const size_t*)trace.data + (d - 1) * (d - 1) + (d - 1);
+			inserted = k == -(ptrdiff_t)d || (k != (ptrdiff_t)d && previous[k - 1] < previous[k + 1]);
+			start_x = inserted ? previous[k + 1] : previous[k - 1] + 1;
+		}
+		while (x > start_x) {
+			--x;
+			--y;
+			json_diff_edit edit = { JSON_DIFF_KEEP, first + x, first + y };
+			if (!json_equal(&a_items[first + x], &b_items[first + y])) {
+				edit.kind = JSON_DIFF_INSERT;
+				vector_push_back(edits, &edit);
+				edit.kind = JSON_DIFF_DELETE;
+			}
+			vector_push_back(edits, &edit);
+		}
+		if (d == 0) break;
+		if (inserted) --y;
+		else --x;
+		json_diff_edit edit = { inserted ? JSON_DIFF_INSERT : JSON_DIFF_DELETE, first + x, first + y };
+		vector_push_back(edits, &edit);
+	}
+	vector_free(&trace);
+
+	json_diff_edit* script = (json_diff_edit*)edits->data;
+	for (size_t i = 0, j = edits->size; i + 1 < j; ++i, --j) {
+		json_diff_edit swap = script[i];
+		script[i] = script[j - 1];
+		script[j - 1] = swap;
+	}
+	return 1;
+}
+
+static void json_diff_array(json_diff_state* state, const json_value* a, size_t ai, const json_value* b, size_t bi)
+{
+	const json_value* a_items = (const json_value*)a->value.array.data;
+	const json_value* b_items = (const json_value*)b->value.array.data;
+	size_t m = a->value.array.size;
+	size_t n = b->value.array.size;
+	size_t* a_children = json_diff_children(a, ai, &state->a_nodes);
+	size_t* b_children = json_diff_children(b, bi, &state->b_nodes);
+
+	// Equal ends are common, only what's between them needs aligning
+	size_t prefix = 0;
+	while (prefix < m && prefix < n && json_diff_same(state, &a_items[prefix], a_children[prefix], &b_items[prefix], b_children[prefix])) ++prefix;
+	size_t a_end = m;
+	size_t b_end = n;
+	while (a_end > prefix && b_end > prefix
+		&& json_diff_same(state, &a_items[a_end - 1], a_children[a_end - 1], &b_items[b_end - 1], b_children[b_end - 1])) {
+		--a_end;
+		--b_end;
+	}
+
+	vector edits;
+	vector_init(&edits, sizeof(json_diff_edit));
+	if (!json_diff_align(state, a, a_children, a_end, b, b_children, b_end, prefix, &edits)) {
+		for (size_t i = prefix; i < a_end; ++i) {
+			json_diff_edit edit = { JSON_DIFF_DELETE, i, 0 };
+			vector_push_back(&edits, &edit);
+		}
+		for (size_t j = prefix; j < b_end; ++j) {
+			json_diff_edit edit = { JSON_DIFF_INSERT, 0, j };
+			vector_push_back(&edits, &edit);
+		}
+	}
+
+	// Between kept elements deletions and insertions are paired up and diffed, which keeps
+	// the patch small when elements were modified rather than replaced
+	json_diff_edit* script = (json_diff_edit*)edits.data;
+	size_t index = prefix;
+	size_t run = 0;
+	while (run < edits.size) {
+		if (script[run].kind == JSON_DIFF_KEEP) {
+			++index;
+			++run;
+			continue;
+		}
+		size_t end = run;
+		size_t deletes = 0;
+		size_t inserts = 0;
+		size_t first_delete = 0;
+		size_t first_insert = 0;
+		for (; end < edits.size && script[end].kind != JSON_DIFF_KEEP; ++end) {
+			if (script[end].kind == JSON_DIFF_DELETE && deletes++ == 0) first_delete = script[end].i;
+			if (script[end].kind == JSON_DIFF_INSERT && inserts++ == 0) first_insert = script[end].j;
+		}
+		size_t pairs = deletes < inserts ? deletes : inserts;
+		for (size_t k = 0; k < pairs; ++k, ++index) {
+			size_t path = json_diff_path_push_index(state, index);
+			size_t i = first_delete + k;
+			size_t j = first_insert + k;
+			json_diff_value(state, &a_items[i], a_children[i], &b_items[j], b_children[j]);
+			state->path.size = path;
+		}
+		for (size_t k = pairs; k < deletes; ++k) {
+			size_t path = json_diff_path_push_index(state, index);
+			json_diff_emit(state, "remove", NULL);
+			state->path.size = path;
+		}
+		for (size_t k = pairs; k < inserts; ++k, ++index) {
+			size_t path = json_diff_path_push_index(state, index);
+			json_diff_emit(state, "add", &b_items[first_insert + k]);
+			state->path.size = path;
+		}
+		run = end;
+	}
+
+	vector_free(&edits);
+	free(a_children);
+	free(b_children);
+}
+
+static void json_diff_value(json_diff_state* state, const json_value* a, size_t ai, const json_value* b, size_t bi)
+{
+	if (json_diff_same(state, a, ai, b, bi)) return;
+	if (a->type == JSON_TYPE_OBJECT && b->type == JSON_TYPE_OBJECT) json_diff_object(state, a, ai, b, bi);
+	else if (a->type == JSON_TYPE_ARRAY && b->type == JSON_TYPE_ARRAY) json_diff_array(state, a, ai, b, bi);
+	else json_diff_emit(state, "replace", b);
+}
+
+void json_diff(const json_value* a, const json_value* b, json_value* patch)
+{
+	json_diff_state state = { .patch = patch };
+	patch->type = JSON_TYPE_ARRAY;
+	patch->flags = 0;
+	vector_init(&patch->value.array, sizeof(json_value));
+	vector_init(&state.a_nodes, sizeof(json_diff_node));
+	vector_init(&state.b_nodes, sizeof(json_diff_node));
+	vector_init(&state.path, sizeof(char));
+
+	json_diff_summarize(a, &state.a_nodes);
+	json_diff_summarize(b, &state.b_nodes);
+	json_diff_value(&state, a, 0, b, 0);
+
+	vector_free(&state.a_nodes);
+	vector_free(&state.b_nodes);
+	vector_free(&state.path);
+}
+
+#ifdef BUILD_TEST
+
+#include <stdio.h>
+
+// Parse target and patch, apply and compare against expected, NULL if the patch must fail
+static void test_patch(const char* target, const char* patch, const char* expected)
+{
+	json_value document, ops, result;
+	assert(json_parse(target, &document));
+	assert(json_parse(patch, &ops));
+	assert(json_parse(expected ? expected : target, &result));
+	assert(json_patch_apply(&document, &ops) == (expected != NULL));
+	assert(json_equal(&document, &result));
+	json_free_value(&document);
+	json_free_value(&ops);
+	json_free_value(&result);
+}
+
+// Diff a against b, check the patch turns a into b and has expected operations
+static void test_diff(const char* a, const char* b, size_t expected)
+{
+	json_value from, to, patch;
+	assert(json_parse(a, &from));
+	assert(json_parse(b, &to));
+	json_diff(&from, &to, &patch);
+	assert(patch.type == JSON_TYPE_ARRAY);
+	assert(patch.value.array.size == expected);
+	assert(json_patch_apply(&from, &patch));
+	assert(json_equal(&from, &to));
+	json_free_value(&from);
+	json_free_value(&to);
+	json_free_value(&patch);
+}
+
+static void test_parse_numbers(const int* numbers, size_t count, json_value* out)
+{
+	vector text;
+	vector_init(&text, sizeof(char));
+	vector_push_back(&text, "[");
+	for (size_t i = 0; i < count; ++i) {
+		char number[16];
+		vector_append(&text, number, (size_t)sprintf(number, i ? ",%d" : "%d", numbers[i]));
+	}
+	vector_append(&text, "]", 2);
+	assert(json_parse(text.data, out));
+	vector_free(&text);
+}
+
+static void test_merge_patch(const char* target, const char* patch, const char* expected)
+{
+	json_value document, changes, result;
+	assert(json_parse(target, &document));
+	assert(json_parse(patch, &changes));
+	assert(json_parse(expected, &result));
+	json_merge_patch(&document, &changes);
+	assert(changes.type == JSON_TYPE_NULL);
+	assert(json_equal(&document, &result));
+	json_free_value(&document);
+	json_free_value(&result);
+}
+
+void json_patch_test_pointer(void)
+{
+	printf("json_patch_test_pointer: ");
+
+	// Examples from RFC 6901
+	json_value root;
+	assert(json_parse("{\"foo\": [\"bar\", \"baz\"], \"\": 0, \"a/b\": 1, \"c%d\": 2, \"e^f\": 3, \"g|h\": 4, "
+		"\"i\\\\j\": 5, \"k\\\"l\": 6, \" \": 7, \"m~n\": 8}", &root));
+	assert(json_pointer_get(&root, "") == &root);
+	assert(json_pointer_get(&root, "/foo")->type == JSON_TYPE_ARRAY);
+	assert(strcmp(json_value_to_string(json_pointer_get(&root, "/foo/0")), "bar") == 0);
+	const char* pointers[] = { "/", "/a~1b", "/c%d", "/e^f", "/g|h", "/i\\j", "/k\"l", "/ ", "/m~0n" };
+	for (int i = 0; i < 9; ++i) {
+		assert(json_value_to_double(json_pointer_get(&root, pointers[i])) == i);
+	}
+
+	assert(json_pointer_get(&root, "foo") == NULL);
+	assert(json_pointer_get(&root, "/foo/2") == NULL);
+	assert(json_pointer_get(&root, "/foo/01") == NULL);
+	assert(json_pointer_get(&root, "/foo/-") == NULL);
+	assert(json_pointer_get(&root, "/foo/0/x") == NULL);
+	assert(json_pointer_get(&root, "/m~2n") == NULL);
+	assert(json_pointer_get(&root, "/missing") == NULL);
+	json_free_value(&root);
+
+	printf(" OK\n");
+}
+
+void json_patch_test_merge(void)
+{
+	printf("json_patch_test_merge: ");
+
+	// Examples from RFC 7386
+	test_merge_patch("{\"a\":\"b\"}", "{\"a\":\"c\"}", "{\"a\":\"c\"}");
+	test_merge_patch("{\"a\":\"b\"}", "{\"b\":\"c\"}", "{\"a\":\"b\",\"b\":\"c\"}");
+	test_merge_patch("{\"a\":\"b\"}", "{\"a\":null}", "{}");
+	test_merge_patch("{\"a\":\"b\",\"b\":\"c\"}", "{\"a\":null}", "{\"b\":\"c\"}");
+	test_merge_patch("{\"a\":[\"b\"]}", "{\"a\":\"c\"}", "{\"a\":\"c\"}");
+	test_merge_patch("{\"a\":\"c\"}", "{\"a\":[\"b\"]}", "{\"a\":[\"b\"]}");
+	test_merge_patch("{\"a\":{\"b\":\"c\"}}", "{\"a\":{\"b\":\"d\",\"c\":null}}", "{\"a\":{\"b\":\"d\"}}");
+	test_merge_patch("{\"a\":[{\"b\":\"c\"}]}", "{\"a\":[1]}", "{\"a\":[1]}");
+	test_merge_patch("[\"a\",\"b\"]", "[\"c\",\"d\"]", "[\"c\",\"d\"]");
+	test_merge_patch("{\"a\":\"b\"}", "[\"c\"]", "[\"c\"]");
+	test_merge_patch("{\"a\":\"foo\"}", "null", "null");
+	test_merge_patch("{\"a\":\"foo\"}", "\"bar\"", "\"bar\"");
+	test_merge_patch("{\"e\":null}", "{\"a\":1}", "{\"e\":null,\"a\":1}");
+	test_merge_patch("[1,2]", "{\"a\":\"b\",\"c\":null}", "{\"a\":\"b\"}");
+	test_merge_patch("{}", "{\"a\":{\"bb\":{\"ccc\":null}}}", "{\"a\":{\"bb\":{}}}");
+
+	// New members are moved over from the patch
+	json_value target, patch;
+	assert(json_parse("{\"keep\" : 1}", &target));
+	assert(json_parse("{\"list\" : [1, 2, 3], \"keep\" : null}", &patch));
+	void* list = json_value_with_key(&patch, "list")->value.array.data;
+	json_merge_patch(&target, &patch);
+	assert(target.value.object.size == 2);
+	assert(json_value_with_key(&target, "list")->value.array.data == list);
+	json_free_value(&target);
+
+	printf(" OK\n");
+}
+
+void json_patch_test_apply(void)
+{
+	printf("json_patch_test_apply: ");
+
+	// Examples from RFC 6902 appendix A
+	test_patch("{\"foo\":\"bar\"}", "[{\"op\":\"add\",\"path\":\"/baz\",\"value\":\"qux\"}]", "{\"baz\":\"qux\",\"foo\":\"bar\"}");
+	test_patch("{\"foo\":[\"bar\",\"baz\"]}", "[{\"op\":\"add\",\"path\":\"/foo/1\",\"value\":\"qux\"}]", "{\"foo\":[\"bar\",\"qux\",\"baz\"]}");
+	test_patch("{\"baz\":\"qux\",\"foo\":\"bar\"}", "[{\"op\":\"remove\",\"path\":\"/baz\"}]", "{\"foo\":\"bar\"}");
+	test_patch("{\"foo\":[\"bar\",\"qux\",\"baz\"]}", "[{\"op\":\"remove\",\"path\":\"/foo/1\"}]", "{\"foo\":[\"bar\",\"baz\"]}");
+	test_patch("{\"baz\":\"qux\",\"foo\":\"bar\"}", "[{\"op\":\"replace\",\"path\":\"/baz\",\"value\":\"boo\"}]", "{\"baz\":\"boo\",\"foo\":\"bar\"}");
+	test_patch("{\"foo\":{\"bar\":\"baz\",\"waldo\":\"fred\"},\"qux\":{\"corge\":\"grault\"}}",
+		"[{\"op\":\"move\",\"from\":\"/foo/waldo\",\"path\":\"/qux/thud\"}]",
+		"{\"foo\":{\"bar\":\"baz\"},\"qux\":{\"corge\":\"grault\",\"thud\":\"fred\"}}");
+	test_patch("{\"foo\":[\"all\",\"grass\",\"cows\",\"eat\"]}", "[{\"op\":\"move\",\"from\":\"/foo/1\",\"path\":\"/foo/3\"}]",
+		"{\"foo\":[\"all\",\"cows\",\"eat\",\"grass\"]}");
+	test_patch("{\"baz\":\"qux\",\"foo\":[\"a\",2,\"c\"]}",
+		"[{\"op\":\"test\",\"path\":\"/baz\",\"value\":\"qux\"},{\"op\":\"test\",\"path\":\"/foo/1\",\"value\":2}]",
+		"{\"baz\":\"qux\",\"foo\":[\"a\",2,\"c\"]}");
+	test_patch("{\"baz\":\"qux\"}", "[{\"op\":\"test\",\"path\":\"/baz\",\"value\":\"bar\"}]", NULL);
+	test_patch("{\"foo\":\"bar\"}", "[{\"op\":\"add\",\"path\":\"/child\",\"value\":{\"grandchild\":{}}}]",
+		"{\"foo\":\"bar\",\"child\":{\"grandchild\":{}}}");
+	test_patch("{\"foo\":\"bar\"}", "[{\"op\":\"add\",\"path\":\"/baz/bat\",\"value\":\"qux\"}]", NULL);
+	test_patch("{\"/\":9,\"~1\":10}", "[{\"op\":\"test\",\"path\":\"/~01\",\"value\":10}]", "{\"/\":9,\"~1\":10}");
+	test_patch("{\"foo\":[\"bar\"]}", "[{\"op\":\"add\",\"path\":\"/foo/-\",\"value\":[\"abc\",\"def\"]}]", "{\"foo\":[\"bar\",[\"abc\",\"def\"]]}");
+
+	// Copies, the whole document and errors
+	test_patch("{\"a\":{\"b\":[1]}}", "[{\"op\":\"copy\",\"from\":\"/a\",\"path\":\"/c\"},{\"op\":\"add\",\"path\":\"/c/b/-\",\"value\":2}]",
+		"{\"a\":{\"b\":[1]},\"c\":{\"b\":[1,2]}}");
+	test_patch("{\"a\":1}", "[{\"op\":\"replace\",\"path\":\"\",\"value\":[true]}]", "[true]");
+	test_patch("{\"a\":1}", "[{\"op\":\"add\",\"path\":\"/a\",\"value\":2}]", "{\"a\":2}");
+	test_patch("{\"a\":{\"b\":1}}", "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/a/c\"}]", NULL);
+	test_patch("{\"a\":1}", "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/a\"}]", "{\"a\":1}");
+	test_patch("{\"a\":1}", "[{\"op\":\"remove\",\"path\":\"\"}]", NULL);
+	test_patch("[1]", "[{\"op\":\"add\",\"path\":\"/2\",\"value\":2}]", NULL);
+	test_patch("[1]", "[{\"op\":\"remove\",\"path\":\"/-\"}]", NULL);
+	test_patch("[1]", "[{\"op\":\"frobnicate\",\"path\":\"/0\"}]", NULL);
+	test_patch("[1]", "[{\"op\":\"replace\",\"path\":\"/0\"}]", NULL);
+	test_patch("[1]", "{\"op\":\"remove\",\"path\":\"/0\"}", NULL);
+
+	// A failing operation undoes everything before it, including moves
+	test_patch("{\"a\":{\"x\":[1,2,3]},\"b\":[4],\"c\":\"s\"}",
+		"[{\"op\":\"remove\",\"path\":\"/a/x/0\"},"
+		"{\"op\":\"move\",\"from\":\"/a/x\",\"path\":\"/b/0\"},"
+		"{\"op\":\"move\",\"from\":\"/c\",\"path\":\"/a/x\"},"
+		"{\"op\":\"add\",\"path\":\"/a/y\",\"value\":{\"n\":null}},"
+		"{\"op\":\"replace\",\"path\":\"\",\"value\":{\"r\":1}},"
+		"{\"op\":\"copy\",\"from\":\"/r\",\"path\":\"/q\"},"
+		"{\"op\":\"move\",\"from\":\"/q\",\"path\":\"/missing/q\"}]",
+		NULL);
+	test_patch("{\"a\":{\"x\":[1,2,3]},\"b\":[4],\"c\":\"s\"}",
+		"[{\"op\":\"remove\",\"path\":\"/a/x/0\"},"
+		"{\"op\":\"move\",\"from\":\"/a/x\",\"path\":\"/b/0\"},"
+		"{\"op\":\"move\",\"from\":\"/c\",\"path\":\"/a/x\"},"
+		"{\"op\":\"test\",\"path\":\"/b\",\"value\":[[2,3],4]}]",
+		"{\"a\":{\"x\":\"s\"},\"b\":[[2,3],4]}");
+
+	// Values are moved out of the patch
+	json_value target, ops;
+	assert(json_parse("{}", &target));
+	assert(json_parse("[{\"op\":\"add\",\"path\":\"/v\",\"value\":[1,2]}]", &ops));
+	void* elements = json_pointer_get(&ops, "/0/value")->value.array.data;
+	assert(json_patch_apply(&target, &ops));
+	assert(json_pointer_get(&target, "/v")->value.array.data == elements);
+	assert(json_pointer_get(&ops, "/0/value")->type == JSON_TYPE_NULL);
+	json_free_value(&ops);
+	json_free_value(&target);
+
+	printf(" OK\n");
+}
+
+void json_patch_test_diff(void)
+{
+	printf("json_patch_test_diff: ");
+
+	test_diff("{\"a\":[1,{\"b\":null}],\"c\":\"x\"}", "{\"c\":\"x\",\"a\":[1,{\"b\":null}]}", 0);
+	test_diff("1", "2", 1);
+	test_diff("{\"a\":1}", "[1]", 1);
+	test_diff("{\"a\":1,\"b\":2,\"c\":3}", "{\"b\":2,\"c\":4,\"d\":5}", 3);
+	test_diff("{\"a/b\":1,\"m~n\":2}", "{\"a/b\":3,\"m~n\":2,\"~/\":4}", 2);
+	test_diff("{\"x\":{\"y\":{\"z\":[1,2,3]}}}", "{\"x\":{\"y\":{\"z\":[1,2,4]}}}", 1);
+
+	// Arrays keep their common subsequence and pair up changed elements
+	test_diff("[1,2,3,4,5]", "[1,2,3,4,5,6]", 1);
+	test_diff("[0,1,2,3,4,5]", "[1,2,3,4,5]", 1);
+	test_diff("[1,2,3,4,5]", "[1,2,9,3,4,5]", 1);
+	test_diff("[1,2,3,4,5]", "[5,1,2,3,4]", 2);
+	test_diff("[1,2,3,4,5]", "[1,3,2,4,5]", 2);
+	test_diff("[{\"id\":1,\"v\":\"a\"},{\"id\":2,\"v\":\"b\"}]", "[{\"id\":1,\"v\":\"a\"},{\"id\":2,\"v\":\"c\"}]", 1);
+	test_diff("[1,2,3]", "[4,5]", 3);
+	test_diff("[]", "[[],{},null]", 3);
+	test_diff("[[],{},null]", "[]", 3);
+	test_diff("[1,[2,3],4]", "[[2,3],4,1]", 2);
+
+	// Of duplicated keys only the first one is reachable by a pointer
+	json_value a, b, patch;
+	assert(json_parse("{\"k\":1,\"k\":2}", &a));
+	assert(json_parse("{\"k\":3,\"k\":2}", &b));
+	json_diff(&a, &b, &patch);
+	assert(patch.value.array.size == 1);
+	assert(strcmp(json_value_to_string(json_pointer_get(&patch, "/0/path")), "/k") == 0);
+	assert(json_value_to_double(json_pointer_get(&patch, "/0/value")) == 3);
+	json_free_value(&patch);
+
+	// Values are copied out of b, b stays as it was
+	json_diff(&a, &a, &patch);
+	assert(patch.value.array.size == 0);
+	json_free_value(&patch);
+	json_value wide;
+	assert(json_parse("{\"k\":3,\"list\":[1,2]}", &wide));
+	json_diff(&b, &wide, &patch);
+	assert(json_pointer_get(&patch, "/0/value")->value.array.data != json_value_with_key(&wide, "list")->value.array.data);
+	json_free_value(&patch);
+	json_free_value(&wide);
+	json_free_value(&a);
+	json_free_value(&b);
+
+	// Long arrays with a few insertions and deletions give a patch of that size
+	size_t count = 20000;
+	int* numbers = malloc((count + 2) * sizeof(int));
+	for (size_t i = 0; i < count; ++i) numbers[i] = (int)i;
+	test_parse_numbers(numbers, count, &a);
+	memmove(&numbers[15001], &numbers[15000], (count - 15000) * sizeof(int));
+	numbers[15000] = -2;
+	memmove(&numbers[10000], &numbers[10001], (count - 10000) * sizeof(int));
+	memmove(&numbers[5001], &numbers[5000], (count - 5000) * sizeof(int));
+	numbers[5000] = -1;
+	test_parse_numbers(numbers, count + 1, &b);
+	json_diff(&a, &b, &patch);
+	assert(patch.value.array.size == 3);
+	assert(json_patch_apply(&a, &patch));
+	assert(json_equal(&a, &b));
+	json_free_value(&patch);
+	json_free_value(&a);
+	json_free_value(&b);
+
+	// Beyond JSON_DIFF_MAX_EDITS elements are paired by position
+	count = JSON_DIFF_MAX_EDITS * 2;
+	for (size_t i = 0; i < count; ++i) numbers[i] = (int)i;
+	test_parse_numbers(numbers, count, &a);
+	for (size_t i = 0; i < count; ++i) numbers[i] = (int)(count - 1 - i);
+	test_parse_numbers(numbers, count, &b);
+	json_diff(&a, &b, &patch);
+	assert(patch.value.array.size == count);
+	assert(json_patch_apply(&a, &patch));
+	assert(json_equal(&a, &b));
+	json_free_value(&patch);
+	json_free_value(&a);
+	json_free_value(&b);
+	free(numbers);
+
+	printf(" OK\n");
+}
+
+void json_patch_test_all(void)
+{
+	json_patch_test_pointer();
+	json_patch_test_merge();
+	json_patch_test_apply();
+	json_patch_test_diff();
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef HS_JSON_PATCH_H
+#define HS_JSON_PATCH_H
+
+#include "json.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Modifying parsed trees in place. Values are moved out of the patch into the target
+// instead of being copied, so the patch is consumed and only good for json_free_value
+// afterwards. Lazily parsed numbers keep pointing into the patch's input. Frozen
+// trees, including values inside them, have to be thawed first
+
+// Value at the JSON Pointer (RFC 6901) in root, NULL if there is none
+json_value* json_pointer_get(json_value* root, const char* pointer);
+
+// Apply an RFC 7386 merge patch to target, this can't fail
+void json_merge_patch(json_value* target, json_value* patch);
+
+// Apply an RFC 6902 patch, an array of operation objects, to target and return 1 if
+// every operation succeeded. A failed patch is rolled back, target ends up equal to
+// what it was but values moved out of ops are lost
+int json_patch_apply(json_value* target, json_value* ops);
+
+// RFC 6902 patch that turns a into b, written to patch as an array of operations with
+// values copied from b. Subtrees are hashed once so identical ones are skipped without
+// walking them again, object members are matched through a hash table and arrays are
+// aligned on their longest common subsequence, in time proportional to their length
+// times the number of inserted and deleted elements. Arrays that need more than
+// JSON_DIFF_MAX_EDITS of those are paired position by position. Of duplicated keys
+// only the first is diffed
+void json_diff(const json_value* a, const json_value* b, json_value* patch);
+
+#ifdef BUILD_TEST
+void json_patch_test_all(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
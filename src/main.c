@@ -1,6 +1,9 @@
 
 #include "vector.h"
 #include "json.h"
+#include "json_parser.h"
+#include "json_columns.h"
+#include "json_patch.h"
 
 int main(int arc, const char* argv[])
 {
@@ -8,6 +11,9 @@ int main(int arc, const char* argv[])
 #ifdef BUILD_TEST
 	vector_test_all();
 	json_test_all();
+	json_parser_test_all();
+	json_columns_test_all();
+	json_patch_test_all();
 #endif
 
 	return 0;
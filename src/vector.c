@@ -62,6 +62,46 @@ void vector_push_back(vector* v, void* data) {
     ++v->size;
 }
 
+// Copies count elements from data to the end, grows at least geometrically so repeated appends stay amortized
+void vector_append(vector* v, const void* data, size_t count) {
+	if (count == 0) return;
+	if (v->size + count > v->capacity) {
+		size_t new_capacity = (v->capacity > 0) ? v->capacity * 2 : 1;
+		if (new_capacity < v->size + count) new_capacity = v->size + count;
+		vector_reserve(v, new_capacity);
+	}
+	memcpy(vector_get(v, v->size), data, count * v->data_size);
+	v->size += count;
+}
+
+// Removes the last element, copies it to data first unless data is NULL
+void vector_pop_back(vector* v, void* data) {
+	assert(v->size > 0);
+	--v->size;
+	if (data) memcpy(data, vector_get(v, v->size), v->data_size);
+}
+
+// Copies count elements from data to index, the elements from index on move back
+void vector_insert(vector* v, size_t index, const void* data, size_t count) {
+	assert(index <= v->size);
+	if (count == 0) return;
+	if (v->size + count > v->capacity) {
+		size_t new_capacity = (v->capacity > 0) ? v->capacity * 2 : 1;
+		if (new_capacity < v->size + count) new_capacity = v->size + count;
+		vector_reserve(v, new_capacity);
+	}
+	memmove(vector_get(v, index + count), vector_get(v, index), (v->size - index) * v->data_size);
+	memcpy(vector_get(v, index), data, count * v->data_size);
+	v->size += count;
+}
+
+// Removes count elements starting at index, the elements after them move forward
+void vector_erase(vector* v, size_t index, size_t count) {
+	assert(index + count <= v->size);
+	memmove(vector_get(v, index), vector_get(v, index + count), (v->size - index - count) * v->data_size);
+	v->size -= count;
+}
+
 void vector_foreach_data(const vector* v, vector_foreach_data_t fp, void* data)
 {
 	if (v == NULL) return;
@@ -182,6 +222,56 @@ void vector_test_reserve(void)
 	vector_free(&v);
 }
 
+void vector_test_append_pop(void)
+{
+	printf("vector_test_append_pop: ");
+	vector v;
+	vector_init(&v, sizeof(int));
+	int vals[] = { 1, 2, 3, 4, 5 };
+	vector_append(&v, vals, 5);
+	assert(v.size == 5);
+	assert(v.capacity >= 5);
+	vector_append(&v, vals, 2);
+	assert(v.size == 7);
+	assert(*(int*)vector_get(&v, 6) == 2);
+
+	int last = 0;
+	vector_pop_back(&v, &last);
+	assert(last == 2);
+	assert(v.size == 6);
+	vector_pop_back(&v, NULL);
+	assert(v.size == 5);
+	assert(*(int*)vector_get(&v, 4) == 5);
+
+	printf("OK\n");
+	vector_free(&v);
+}
+
+void vector_test_insert_erase(void)
+{
+	printf("vector_test_insert_erase: ");
+	vector v;
+	vector_init(&v, sizeof(int));
+	int vals[] = { 1, 2, 3, 4, 5 };
+	vector_insert(&v, 0, vals, 2);
+	vector_insert(&v, 2, vals + 3, 2);
+	vector_insert(&v, 2, vals + 2, 1);
+	assert(v.size == 5);
+	for (int i = 0; i < 5; ++i) assert(*(int*)vector_get(&v, i) == i + 1);
+
+	vector_erase(&v, 1, 2);
+	assert(v.size == 3);
+	assert(*(int*)vector_get(&v, 0) == 1);
+	assert(*(int*)vector_get(&v, 1) == 4);
+	vector_erase(&v, 2, 1);
+	vector_erase(&v, 0, 0);
+	assert(v.size == 2);
+	assert(*(int*)vector_get(&v, 1) == 4);
+
+	printf("OK\n");
+	vector_free(&v);
+}
+
 void foreach_increment_nodata(void* item)
 {
 	assert(item != NULL);
@@ -293,6 +383,8 @@ void vector_test_all(void)
 	vector_test_insert_read_struct();
 	vector_test_safe_get();
 	vector_test_reserve();
+	vector_test_append_pop();
+	vector_test_insert_erase();
 	vector_test_foreach_nodata();
 	vector_test_foreach_data_1();
 	vector_test_foreach_data_2();
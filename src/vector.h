@@ -3,6 +3,10 @@
 
 #include <stddef.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct {
     size_t capacity;
     size_t data_size;
@@ -22,6 +26,14 @@ void vector_reserve(vector* v, size_t new_capacity);
 
 void vector_push_back(vector* v, void* data);
 
+void vector_append(vector* v, const void* data, size_t count);
+
+void vector_pop_back(vector* v, void* data);
+
+void vector_insert(vector* v, size_t index, const void* data, size_t count);
+
+void vector_erase(vector* v, size_t index, size_t count);
+
 
 typedef void(*vector_foreach_t)(void*);
 
@@ -35,4 +47,8 @@ void vector_foreach_data(const vector* v, vector_foreach_data_t fp, void* data);
 void vector_test_all();
 #endif
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif